@@ -1,12 +1,16 @@
 #include "devices/timer.h"
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stdio.h>
 #include "devices/pit.h"
+#include "threads/histogram.h"
 #include "threads/interrupt.h"
+#include "threads/intr-profile.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/tsc.h"
   
 /* See [8254] for hardware details of the 8254 timer chip. */
 
@@ -24,6 +28,88 @@ static int64_t ticks;
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/* If true, the idle thread stops the periodic tick while it
+   halts.  Controlled by kernel command-line option "-tickless". */
+bool timer_tickless;
+
+/* If nonzero, timer_calibrate() uses this as loops_per_tick
+   instead of measuring it.  Set by kernel command-line option
+   "-lpt=N", normally to a value printed by an earlier boot. */
+unsigned timer_preset_loops;
+
+/* If true, timer_calibrate() times busy_wait() with the TSC
+   against a single PIT interval instead of searching for
+   loops_per_tick tick by tick.  Set by "-calibrate=tsc". */
+bool timer_calibrate_tsc;
+
+/* If nonzero, set by kernel command-line option
+   "-virtual-time[=POLLS]", the clock runs on virtual time once
+   timer_calibrate() is done: the 8254's interrupts are ignored,
+   and instead a tick is injected every POLLS calls to
+   timer_ticks() from a thread with interrupts on, and on every
+   pass of the idle loop.  Ticks then go by as fast as the
+   threads poll, but thread_tick() and the wakeups see exactly
+   the tick sequence they would in real time, so MLFQ
+   accounting, demotion and boosting decide the same way. */
+int timer_virtual_polls;
+
+/* True once virtual time has started. */
+static bool virtual_active;
+
+/* Polls of timer_ticks() since the last virtual tick. */
+static int virtual_polls;
+
+/* Set just before a virtual tick's `int' instruction, so that
+   timer_interrupt() can tell it from the 8254's. */
+static bool virtual_tick_pending;
+
+/* Loops timed by calibrate_tsc(), enough to swamp the cost of
+   reading the TSC without taking long on a slow CPU. */
+#define TSC_CALIBRATION_LOOPS (1u << 16)
+
+/* PIT cycles per timer tick, as loaded by timer_init(). */
+#define PIT_TICK_COUNT ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Longest count loaded for a tickless sleep.  Kept well below
+   65535 so that timer_idle_exit() can tell a counter that has
+   already expired and wrapped around from one still counting. */
+#define PIT_ONESHOT_MAX 0xf000
+
+/* Sub-tick sleeps shorter than this many PIT cycles (about 100 us)
+   busy-wait instead, since blocking would cost more than that. */
+#define FINE_SLEEP_MIN (PIT_HZ / 10000)
+
+/* ===================================================================== */
+/* Tickless idle: while the idle thread halts, channel 0 is switched to  */
+/* one-shot mode and fires at the boundary of the tick on which the      */
+/* earliest sleeper is due, skipping the ticks in between.  The one-shot */
+/* always expires exactly on a tick boundary, so `ticks' stays in step   */
+/* with the periodic timer we return to afterward.                      */
+/*                                                                       */
+/* Sub-tick sleeps use the same machinery with oneshot_ticks == 0: the   */
+/* one-shot fires in the middle of the current tick, at the earliest     */
+/* fine sleeper's deadline, and timer_interrupt() then re-arms it for    */
+/* the oneshot_first cycles left to the tick boundary.                   */
+/* ===================================================================== */
+static bool oneshot_armed;            /* Channel 0 is in one-shot mode. */
+static unsigned oneshot_count;        /* PIT cycles the one-shot was loaded with. */
+static unsigned oneshot_first;        /* PIT cycles from arming to first boundary,
+                                         or from a mid-tick expiry to it. */
+static int64_t oneshot_ticks;         /* Tick boundaries up to and including expiry. */
+/* ===================================================================== */
+
+/* A thread blocked in a sub-tick sleep.  Deadlines are in PIT
+   cycles since boot, as returned by fine_now(). */
+struct fine_sleeper
+  {
+    struct list_elem elem;            /* Element in fine_sleepers. */
+    struct thread *thread;            /* The sleeping thread. */
+    int64_t deadline;                 /* PIT cycle to wake at. */
+  };
+
+/* Sub-tick sleepers, in order of deadline. */
+static struct list fine_sleepers;
+
 /* ===================================================================== */
 /* These lines are from Lab 3:                                                   */
 /* We added a list to keep track of threads that are sleeping.             */
@@ -31,12 +117,33 @@ static unsigned loops_per_tick;
 /* added to this list. The timer interrupt will check this list          */
 /* every tick and wake up threads when their sleep time is over.         */
 /* ===================================================================== */
-static struct list sleep_list;
+/* The unsorted sleep_list is now a pairing heap ordered by wake_tick.   */
+/* Its root is always the next thread to wake, so a tick on which no     */
+/* sleeper is due costs one comparison, and waking K threads costs       */
+/* K amortized O(log n) pops instead of a walk over every sleeper.       */
+/* ===================================================================== */
+static struct sleeping_thread *sleep_heap;
+
+/* Number of threads in the sleep heap, that is, blocked in
+   timer_sleep() as opposed to waiting on a synchronization
+   object. */
+static int sleeper_cnt;
+
+/* Set by timer_interrupt() when the root of the sleep heap is due.
+   The interrupt only notes that and asks to yield; the wakeups
+   themselves run, all in one pass, when thread_yield() calls
+   timer_run_wakeups() on the way out of the interrupt. */
+static bool wakeups_pending;
+
+#ifdef SCHED_STATS
+/* Ticks from each sleeper's wake_tick until it ran again. */
+static struct histogram wakeup_lateness;
+#endif
 
 /* from Lab3:                                                   */
 /* This structure holds information about each sleeping thread.          */
 /* We store which thread is sleeping, when it should wake up,            */
-/* and a list element so we can link these in the sleep_list.            */
+/* and the links that place it in the sleep heap.                        */
 /* ===================================================================== */
 /* for lab4:                                                   */
 /* we also saveed the thread's MLFQ priority and tick count.               */
@@ -48,17 +155,32 @@ struct sleeping_thread
 {
   struct thread *thread;              /* The sleeping thread */
   int64_t wake_tick;                  /* When to wake this thread */
+  int64_t sleep_tick;                 /* When it went to sleep */
   int saved_mlfq_priority;            /* LAB 4: Save priority during sleep */
   int saved_ticks_at_priority;        /* LAB 4: Save quantum usage during sleep */
-  struct list_elem elem;              /* Link for the sleep_list */
+  unsigned saved_boost_epoch;         /* Last boost applied before sleeping */
+  struct sleeping_thread *child;      /* First child in the sleep heap */
+  struct sleeping_thread *sibling;    /* Next sibling in the sleep heap */
 };
 /* ===================================================================== */
 
+static struct sleeping_thread *sleep_heap_meld (struct sleeping_thread *,
+                                                struct sleeping_thread *);
+static struct sleeping_thread *sleep_heap_pop (void);
 static intr_handler_func timer_interrupt;
 static bool too_many_loops (unsigned loops);
+static unsigned calibrate_search (void);
+static unsigned calibrate_tsc (void);
+static void virtual_tick (void);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
 static void real_time_delay (int64_t num, int32_t denom);
+static void fine_sleep (int64_t cycles);
+static int64_t fine_now (void);
+static void fine_arm (void);
+static void fine_wake (void);
+static bool fine_sleeper_less (const struct list_elem *,
+                               const struct list_elem *, void *aux);
 
 /* Sets up the timer to interrupt TIMER_FREQ times per second,
    and registers the corresponding interrupt. */
@@ -70,20 +192,52 @@ timer_init (void)
   
   /* ================================================================= */
   /* form lab3:                                               */
-  /* Initialized the sleep list as empty when the timer starts.         */
+  /* Initialized the sleep heap as empty when the timer starts.         */
   /* ================================================================= */
-  list_init (&sleep_list);
+  sleep_heap = NULL;
+  list_init (&fine_sleepers);
   /* ================================================================= */
 }
 
-/* Calibrates loops_per_tick, used to implement brief delays. */
+/* Calibrates loops_per_tick, used to implement brief delays.
+   With -virtual-time, the clock switches to virtual ticks once
+   this is done, since calibration needs real ones. */
 void
 timer_calibrate (void) 
 {
-  unsigned high_bit, test_bit;
-
   ASSERT (intr_get_level () == INTR_ON);
-  printf ("Calibrating timer...  ");
+
+  if (timer_preset_loops != 0)
+    {
+      loops_per_tick = timer_preset_loops;
+      printf ("Timer preset to %'"PRIu64" loops/s.\n",
+              (uint64_t) loops_per_tick * TIMER_FREQ);
+    }
+  else
+    {
+      printf ("Calibrating timer...  ");
+      loops_per_tick = timer_calibrate_tsc ? calibrate_tsc () : calibrate_search ();
+      printf ("%'"PRIu64" loops/s (-lpt=%u).\n",
+              (uint64_t) loops_per_tick * TIMER_FREQ, loops_per_tick);
+    }
+
+  if (timer_virtual_polls > 0)
+    {
+      printf ("Timer switching to virtual time, %d polls per tick.\n",
+              timer_virtual_polls);
+      virtual_active = true;
+    }
+}
+
+/* Returns loops_per_tick as found by searching for the largest
+   number of busy_wait() loops that still fit in one timer tick.
+   Each probe waits out a tick or two, so this takes a couple of
+   dozen ticks. */
+static unsigned
+calibrate_search (void)
+{
+  unsigned loops_per_tick;
+  unsigned high_bit, test_bit;
 
   /* Approximate loops_per_tick as the largest power-of-two
      still less than one timer tick. */
@@ -99,17 +253,60 @@ timer_calibrate (void)
   for (test_bit = high_bit >> 1; test_bit != high_bit >> 10; test_bit >>= 1)
     if (!too_many_loops (loops_per_tick | test_bit))
       loops_per_tick |= test_bit;
+  return loops_per_tick;
+}
+
+/* Returns loops_per_tick as measured with the TSC: counts TSC
+   cycles across one whole timer tick, then times a fixed number
+   of busy_wait() loops in TSC cycles and scales.  This takes a
+   little over two ticks, against the two dozen or so of the
+   search in timer_calibrate(). */
+static unsigned
+calibrate_tsc (void)
+{
+  uint64_t tsc_per_tick, loop_tsc, loops;
+  enum intr_level old_level;
+  int64_t start;
+
+  /* Wait for a timer tick, then time the next one. */
+  start = ticks;
+  while (ticks == start)
+    barrier ();
+  tsc_per_tick = rdtsc ();
+  start = ticks;
+  while (ticks == start)
+    barrier ();
+  tsc_per_tick = rdtsc () - tsc_per_tick;
+
+  /* Time the loops with interrupts off, so that the measurement
+     does not include a timer interrupt. */
+  old_level = intr_disable ();
+  loop_tsc = rdtsc ();
+  busy_wait (TSC_CALIBRATION_LOOPS);
+  loop_tsc = rdtsc () - loop_tsc;
+  intr_set_level (old_level);
 
-  printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
+  if (loop_tsc == 0)
+    loop_tsc = 1;
+  loops = TSC_CALIBRATION_LOOPS * tsc_per_tick / loop_tsc;
+  ASSERT (loops != 0 && loops <= UINT32_MAX);
+  return loops;
 }
 
 /* Returns the number of timer ticks since the OS booted. */
 int64_t
 timer_ticks (void) 
 {
-  enum intr_level old_level = intr_disable ();
+  enum intr_level old_level = INTR_PROFILE_DISABLE ();
   int64_t t = ticks;
-  intr_set_level (old_level);
+  INTR_PROFILE_SET_LEVEL (old_level);
+
+  if (virtual_active && old_level == INTR_ON && !intr_context ()
+      && ++virtual_polls >= timer_virtual_polls)
+    {
+      virtual_polls = 0;
+      virtual_tick ();
+    }
   return t;
 }
 
@@ -129,7 +326,7 @@ timer_elapsed (int64_t then)
 /* calling thread_yield). This wasted CPU time.                          */
 /*                                                                        */
 /* we created a sleeping_thread structure, added it to the    */
-/* sleep_list, and then blocked the thread. The thread stops running       */
+/* sleep heap, and then blocked the thread. The thread stops running       */
 /* completely until the timer interrupt wakes it up later.               */
 /* ===================================================================== */
 /* additions for lab4:                                                   */
@@ -153,6 +350,7 @@ timer_sleep (int64_t ticks)
   /* Set up the sleeping thread structure */
   st.thread = cur;
   st.wake_tick = start + ticks;
+  st.sleep_tick = start;
   
  
   /* This lets the thread resume at the same priority after waking up. */
@@ -160,14 +358,21 @@ timer_sleep (int64_t ticks)
     {
       st.saved_mlfq_priority = cur->mlfq_priority;
       st.saved_ticks_at_priority = cur->ticks_at_priority;
+      st.saved_boost_epoch = cur->boost_epoch;
     }
 
-  /* Add this thread to the sleep list and block it */
+  /* Add this thread to the sleep heap and block it */
   /* Blocking means the thread stops running until it's unblocked */
-  enum intr_level old_level = intr_disable ();
-  list_push_back (&sleep_list, &st.elem);
+  st.child = st.sibling = NULL;
+  enum intr_level old_level = INTR_PROFILE_DISABLE ();
+  sleep_heap = sleep_heap_meld (sleep_heap, &st);
+  sleeper_cnt++;
   thread_block ();
-  intr_set_level (old_level);
+  INTR_PROFILE_SET_LEVEL (old_level);
+
+#ifdef SCHED_STATS
+  histogram_add (&wakeup_lateness, timer_ticks () - st.wake_tick);
+#endif
   
   /* REMOVED FOR LAB 3: The busy-waiting while loop */
   /* Original code that we replaced: */
@@ -176,6 +381,128 @@ timer_sleep (int64_t ticks)
 }
 /* ===================================================================== */
 
+/* Returns the tick at which the earliest sleeping thread is due
+   to wake up, or INT64_MAX if no thread is sleeping. */
+int64_t
+timer_next_wakeup (void)
+{
+  enum intr_level old_level = intr_disable ();
+  int64_t t = sleep_heap != NULL ? sleep_heap->wake_tick : INT64_MAX;
+  intr_set_level (old_level);
+  return t;
+}
+
+/* Called by the idle thread, with interrupts off, just before it
+   halts.  If tickless idle is enabled and no sleeper is due at the
+   next tick, switches the timer to a one-shot interrupt at the
+   tick boundary on which the earliest sleeper is due (or as far
+   ahead as the 16-bit PIT counter reaches).
+
+   The MLFQ boost counter only advances on ticks that a non-idle
+   thread runs, so skipping idle ticks does not move the next
+   boost.  Other interrupt handlers that run while the tick is
+   stopped see a `ticks' value that lags until timer_idle_exit(). */
+void
+timer_idle_enter (void)
+{
+  int64_t n;
+  unsigned first, max_ticks;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!timer_tickless || virtual_active || oneshot_armed
+      || !list_empty (&fine_sleepers))
+    return;
+
+  /* Number of tick boundaries until the earliest wakeup. */
+  n = sleep_heap != NULL ? sleep_heap->wake_tick - ticks : INT64_MAX;
+
+  /* PIT cycles left in the current tick.  Loading the one-shot
+     with this plus whole ticks keeps the tick phase unchanged. */
+  first = pit_read_count (0);
+  if (first == 0 || first > PIT_TICK_COUNT)
+    return;
+  max_ticks = 1 + (PIT_ONESHOT_MAX - first) / PIT_TICK_COUNT;
+  if (n > max_ticks)
+    n = max_ticks;
+  if (n < 2)
+    return;
+
+  oneshot_first = first;
+  oneshot_ticks = n;
+  oneshot_count = first + (n - 1) * PIT_TICK_COUNT;
+  oneshot_armed = true;
+  pit_configure_count (0, 0, oneshot_count);
+}
+
+/* Called with interrupts off when the idle thread stops idling,
+   either because it is about to run again or because another
+   thread is being switched in after an interrupt other than the
+   timer woke the CPU.  Accounts for the whole ticks that went by
+   during a tickless sleep and arranges a one-shot at the next
+   tick boundary, where timer_interrupt() restores the periodic
+   timer. */
+void
+timer_idle_exit (void)
+{
+  unsigned left, elapsed;
+  int64_t k;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!oneshot_armed || oneshot_ticks < 2)
+    return;
+
+  /* If the one-shot already expired, its interrupt is pending and
+     timer_interrupt() will account for the whole sleep. */
+  left = pit_read_count (0);
+  if (left == 0 || left > oneshot_count)
+    return;
+
+  /* Tick boundaries passed so far.  This is less than
+     oneshot_ticks because the last one is the expiry itself. */
+  elapsed = oneshot_count - left;
+  k = elapsed < oneshot_first ? 0 : 1 + (elapsed - oneshot_first) / PIT_TICK_COUNT;
+  ticks += k;
+  thread_skip_idle_ticks (k);
+
+  oneshot_ticks = 1;
+  oneshot_first = oneshot_count = oneshot_first + k * PIT_TICK_COUNT - elapsed;
+  pit_configure_count (0, 0, oneshot_count);
+}
+
+/* Called by the idle thread, with interrupts off, in place of
+   halting.  In virtual time there is no interrupt to wait for, so
+   injects the next tick and returns true.  Otherwise returns
+   false. */
+bool
+timer_virtual_idle (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!virtual_active)
+    return false;
+  virtual_tick ();
+  return true;
+}
+
+/* Runs timer_interrupt() for one virtual tick through the usual
+   interrupt path, so that a preemption it requests happens on
+   return exactly as for the 8254.  Must not be called from an
+   interrupt handler. */
+static void
+virtual_tick (void)
+{
+  enum intr_level old_level;
+
+  ASSERT (!intr_context ());
+
+  old_level = intr_disable ();
+  virtual_tick_pending = true;
+  asm volatile ("int $0x20" : : : "memory");
+  intr_set_level (old_level);
+}
+
 /* Sleeps for approximately MS milliseconds.  Interrupts must be
    turned on. */
 void
@@ -244,61 +571,199 @@ void
 timer_print_stats (void) 
 {
   printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+  printf ("Timer: %d threads sleeping\n", sleeper_cnt);
+#ifdef SCHED_STATS
+  histogram_print ("Timer: wakeup lateness (ticks):", &wakeup_lateness);
+#endif
 }
 
 /* Timer interrupt handler. */
 /* ===================================================================== */                                                  */
 /* The original version just incremented ticks and called thread_tick(). */
-/* We now check the sleep_list every tick to see if any    */
-/* sleeping threads need to wake up. If a thread's wake_tick has been    */
-/* reached, we remove it from the sleep_list and unblock it (which       */
-/* adds it back to the ready queue so it can run again).                 */
+/* We now check the sleep heap every tick to see if any    */
+/* sleeping threads need to wake up. The heap root is the earliest       */
+/* wake_tick, so a tick on which it is not due costs one comparison.    */
+/* When it is due, timer_run_wakeups() pops and unblocks the due         */
+/* threads (which adds them back to the ready queue so they can run     */
+/* again) after the handler returns, in thread_yield().                 */
+/* ===================================================================== */
+static void
+timer_interrupt (struct intr_frame *args UNUSED)
+{
+  /* In virtual time only injected ticks count. */
+  if (virtual_active)
+    {
+      if (!virtual_tick_pending)
+        return;
+      virtual_tick_pending = false;
+    }
+
+  /* A one-shot for a sub-tick sleeper expired mid-tick: wake it,
+     finish the tick with a one-shot to its boundary, and arm for
+     the next sub-tick sleeper due before then, if any. */
+  if (oneshot_armed && oneshot_ticks == 0)
+    {
+      oneshot_ticks = 1;
+      oneshot_count = oneshot_first;
+      pit_configure_count (0, 0, oneshot_count);
+      fine_wake ();
+      fine_arm ();
+      return;
+    }
+
+  /* A one-shot expired on a tick boundary: account for the idle
+     ticks it skipped and go back to the periodic timer. */
+  if (oneshot_armed)
+    {
+      int64_t skipped = oneshot_ticks - 1;
+
+      oneshot_armed = false;
+      pit_configure_channel (0, 2, TIMER_FREQ);
+      ticks += skipped;
+      thread_skip_idle_ticks (skipped);
+    }
+
+  ticks++;
+  thread_tick ();
+
+  /* Leave the wakeups for thread_yield(); nothing to do if the
+     root isn't due. */
+  if (sleep_heap != NULL && ticks >= sleep_heap->wake_tick)
+    {
+      wakeups_pending = true;
+      intr_yield_on_return ();
+    }
+
+  /* Sub-tick sleepers due now, or later in the new tick. */
+  fine_wake ();
+  fine_arm ();
+}
+/* ===================================================================== */
+
 /* ===================================================================== */
 /* for lab4:                                                   */
 /* Before unblocking a thread, we restore its MLFQ priority and          */
 /* quantum usage that we saved when it went to sleep. This ensures       */
 /* the thread continues at the same priority level it had before.        */
 /* ===================================================================== */
-static void
-timer_interrupt (struct intr_frame *args UNUSED)
+/* Wakes every sleeper that timer_interrupt() found due, if it
+   found any, restoring each one's MLFQ state first.  Called by
+   thread_yield() with interrupts off once the interrupt handler
+   has returned, so the threads go onto the ready queues without a
+   preemption check each and the caller decides once whether to
+   switch.  Returns true if there were wakeups to run. */
+bool
+timer_run_wakeups (void)
 {
-  struct list_elem *e;
-  
-  ticks++;
-  thread_tick ();
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (!intr_context ());
+
+  if (!wakeups_pending)
+    return false;
+  wakeups_pending = false;
 
-  /* Walk through the sleep list and check each sleeping thread */
-  e = list_begin (&sleep_list);
-  while (e != list_end (&sleep_list))
+  INTR_PROFILE_SPAN_BEGIN (wakeup_start);
+  while (sleep_heap != NULL && ticks >= sleep_heap->wake_tick)
     {
-      struct sleeping_thread *st = list_entry (e, struct sleeping_thread, elem);
-      
-      /* Is it time to wake this thread? */
-      if (ticks >= st->wake_tick)
-        {
-          struct thread *t = st->thread;
-          
-          /* addition made for lab4: restore the thread's MLFQ state before waking it up */
-          /* this puts the thread back in the same priority queue it was */
-          /* in before sleeping, with the same quantum usage. */
-          if (thread_mlfqs)
-            {
-              t->mlfq_priority = st->saved_mlfq_priority;
-              t->ticks_at_priority = st->saved_ticks_at_priority;
-            }
+      struct sleeping_thread *st = sleep_heap_pop ();
+      struct thread *t = st->thread;
+
+      sleeper_cnt--;
           
-          /* Remove from sleep list and wake up the thread */
-          e = list_remove (e);
-          thread_unblock (t);
+      /* addition made for lab4: restore the thread's MLFQ state before waking it up */
+      /* this puts the thread back in the same priority queue it was */
+      /* in before sleeping, with the same quantum usage. */
+      /* The dispatch table's slpret, or sleep credit, may move it
+         to another level, in which case it starts a fresh quantum
+         there. */
+      if (thread_mlfqs)
+        {
+          int level = mlfq_dispatch_table[st->saved_mlfq_priority].slpret;
+
+          level = thread_mlfq_wake_level (t, level, ticks - st->sleep_tick);
+
+          t->mlfq_priority = level;
+          t->ticks_at_priority
+            = mlfq_policy_wake_ticks (st->saved_mlfq_priority,
+                                      st->saved_ticks_at_priority, level);
+          t->boost_epoch = st->saved_boost_epoch;
         }
-      else
+      THREAD_TRACE (SCHED_EV_WAKEUP, t, t->mlfq_priority, t->mlfq_priority);
+          
+      /* Wake up the thread.  If a boost happened while it slept,
+         thread_unblock() applies it on top of the restored state. */
+      thread_unblock (t);
+    }
+  INTR_PROFILE_SPAN_END (wakeup_start);
+  return true;
+}
+
+/* Melds sleep heaps A and B and returns the root of the result.
+   Either may be null.  On a tie A stays on top, so threads due on
+   the same tick keep roughly the order in which they slept. */
+static struct sleeping_thread *
+sleep_heap_meld (struct sleeping_thread *a, struct sleeping_thread *b)
+{
+  if (a == NULL)
+    return b;
+  if (b == NULL)
+    return a;
+  if (b->wake_tick < a->wake_tick)
+    {
+      struct sleeping_thread *tmp = a;
+      a = b;
+      b = tmp;
+    }
+  b->sibling = a->child;
+  a->child = b;
+  return a;
+}
+
+/* Removes and returns the root of the (non-empty) sleep heap.
+   The root's children are melded back together with the usual
+   two-pass pairing, done iteratively because this runs in the
+   timer interrupt on a small kernel stack. */
+static struct sleeping_thread *
+sleep_heap_pop (void)
+{
+  struct sleeping_thread *root = sleep_heap;
+  struct sleeping_thread *next = root->child;
+  struct sleeping_thread *pairs = NULL;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  /* First pass: meld children in pairs, left to right, stacking
+     each result onto PAIRS through its sibling link. */
+  while (next != NULL)
+    {
+      struct sleeping_thread *a = next;
+      struct sleeping_thread *b = a->sibling;
+
+      if (b != NULL)
         {
-          /* Not time yet, check the next sleeping thread */
-          e = list_next (e);
+          next = b->sibling;
+          a->sibling = b->sibling = NULL;
+          a = sleep_heap_meld (a, b);
         }
+      else
+        next = NULL;
+      a->sibling = pairs;
+      pairs = a;
+    }
+
+  /* Second pass: meld the stacked pairs right to left. */
+  sleep_heap = NULL;
+  while (pairs != NULL)
+    {
+      struct sleeping_thread *p = pairs;
+      pairs = p->sibling;
+      p->sibling = NULL;
+      sleep_heap = sleep_heap_meld (sleep_heap, p);
     }
+
+  root->child = root->sibling = NULL;
+  return root;
 }
-/* ===================================================================== */
 
 /* Returns true if LOOPS iterations waits for more than one timer
    tick, otherwise false. */
@@ -355,12 +820,118 @@ real_time_sleep (int64_t num, int32_t denom)
     }
   else 
     {
-      /* Otherwise, use a busy-wait loop for more accurate
-         sub-tick timing. */
-      real_time_delay (num, denom); 
+      /* Otherwise block until a one-shot timer interrupt in the
+         middle of the tick, unless the delay is too short to be
+         worth it, in which case use a busy-wait loop. */
+      int64_t cycles = num * PIT_HZ / denom;
+
+      if (cycles >= FINE_SLEEP_MIN && !virtual_active)
+        fine_sleep (cycles);
+      else
+        real_time_delay (num, denom); 
+    }
+}
+
+/* Blocks the running thread for CYCLES PIT cycles, less than a
+   timer tick's worth. */
+static void
+fine_sleep (int64_t cycles)
+{
+  struct fine_sleeper fs;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  fs.thread = thread_current ();
+  fs.deadline = fine_now () + cycles;
+  list_insert_ordered (&fine_sleepers, &fs.elem, fine_sleeper_less, NULL);
+  fine_arm ();
+  thread_block ();
+  intr_set_level (old_level);
+}
+
+/* Returns the number of PIT cycles since boot, as far as the timer
+   interrupt has accounted for them, which can lag by a tick if a
+   tick boundary passed while interrupts were off.  Not valid
+   during a multi-tick tickless one-shot, which only the idle
+   thread sees.  Interrupts must be off. */
+static int64_t
+fine_now (void)
+{
+  unsigned left = pit_read_count (0);
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  /* LEFT is the cycles to the tick boundary, except when a
+     mid-tick one-shot is pending, when it is the cycles to that. */
+  if (oneshot_armed && oneshot_ticks == 0)
+    left += oneshot_first;
+  return ticks * PIT_TICK_COUNT + (PIT_TICK_COUNT - left);
+}
+
+/* Arms a mid-tick one-shot for the earliest sub-tick sleeper if
+   it is due before the next tick boundary and nothing earlier is
+   armed.  A sleeper due later is looked at again by the timer
+   interrupt at that boundary.  Interrupts must be off. */
+static void
+fine_arm (void)
+{
+  struct fine_sleeper *fs;
+  unsigned left;
+  int64_t until;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (list_empty (&fine_sleepers)
+      || (oneshot_armed && oneshot_ticks != 1))
+    return;
+
+  fs = list_entry (list_front (&fine_sleepers), struct fine_sleeper, elem);
+  left = pit_read_count (0);
+  until = fs->deadline - fine_now ();
+  if (until < 1)
+    until = 1;
+  if (left == 0 || left > PIT_TICK_COUNT || until >= left)
+    return;
+
+  oneshot_first = left - until;
+  oneshot_count = until;
+  oneshot_ticks = 0;
+  oneshot_armed = true;
+  pit_configure_count (0, 0, oneshot_count);
+}
+
+/* Wakes every sub-tick sleeper whose deadline has passed.
+   Interrupts must be off. */
+static void
+fine_wake (void)
+{
+  int64_t now = fine_now ();
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (!list_empty (&fine_sleepers))
+    {
+      struct fine_sleeper *fs = list_entry (list_front (&fine_sleepers),
+                                            struct fine_sleeper, elem);
+      if (fs->deadline > now)
+        break;
+      list_pop_front (&fine_sleepers);
+      thread_unblock (fs->thread);
     }
 }
 
+/* Orders fine sleepers by deadline, earliest first, and FIFO
+   among equal deadlines. */
+static bool
+fine_sleeper_less (const struct list_elem *a_, const struct list_elem *b_,
+                   void *aux UNUSED)
+{
+  const struct fine_sleeper *a = list_entry (a_, struct fine_sleeper, elem);
+  const struct fine_sleeper *b = list_entry (b_, struct fine_sleeper, elem);
+
+  return a->deadline < b->deadline;
+}
+
 /* Busy-wait for approximately NUM/DENOM seconds. */
 static void
 real_time_delay (int64_t num, int32_t denom)
@@ -0,0 +1,52 @@
+#ifndef DEVICES_TIMER_H
+#define DEVICES_TIMER_H
+
+#include <round.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Number of timer interrupts per second. */
+#define TIMER_FREQ 100
+
+/* Stop the periodic tick while idle?  Set by "-tickless". */
+extern bool timer_tickless;
+
+/* Loops per tick given by "-lpt=N", or 0 to calibrate. */
+extern unsigned timer_preset_loops;
+
+/* Calibrate against the TSC?  Set by "-calibrate=tsc". */
+extern bool timer_calibrate_tsc;
+
+/* timer_ticks() polls per virtual tick, or 0 for real time.  Set
+   by "-virtual-time". */
+extern int timer_virtual_polls;
+
+void timer_init (void);
+void timer_calibrate (void);
+
+int64_t timer_ticks (void);
+int64_t timer_elapsed (int64_t);
+
+/* Sleep and yield the CPU to other threads. */
+void timer_sleep (int64_t ticks);
+void timer_msleep (int64_t milliseconds);
+void timer_usleep (int64_t microseconds);
+void timer_nsleep (int64_t nanoseconds);
+
+/* Tick at which the earliest sleeping thread wakes up. */
+int64_t timer_next_wakeup (void);
+bool timer_run_wakeups (void);
+
+/* Tickless idle, called by the idle thread with interrupts off. */
+void timer_idle_enter (void);
+void timer_idle_exit (void);
+bool timer_virtual_idle (void);
+
+/* Busy waits. */
+void timer_mdelay (int64_t milliseconds);
+void timer_udelay (int64_t microseconds);
+void timer_ndelay (int64_t nanoseconds);
+
+void timer_print_stats (void);
+
+#endif /* devices/timer.h */
@@ -0,0 +1,120 @@
+/* Measures the cost of an MLFQ boost as the number of threads
+   grows.  For each of 1, 10 and 100 threads, the threads spin
+   long enough to sink to the lower queues, then the main thread
+   times thread_mlfq_boost() with interrupts off.  The boost is
+   meant to cost O(MLFQ_NUM_QUEUES) however many threads there
+   are, so the three numbers should stay close.
+
+   The boost is lazy, though: each thread resets its own MLFQ
+   state when it is next dispatched.  The main thread therefore
+   also times the first dispatch round after the boost, from the
+   boost to the last spinner checking in, with each spinner
+   blocking as soon as it has checked in.  That round grows with
+   the number of threads, since it includes their context
+   switches as well as their catch-up.
+
+   The periodic boost is turned off while the test runs so that
+   it does not reset the spinners.  The results are printed as
+   "bench" lines for scripts to pick up; there are no expected
+   values. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/tsc.h"
+
+/* Ticks the spinners get to sink before the boost. */
+#define SINK_TICKS 100
+
+struct boost_round
+  {
+    int thread_cnt;             /* Number of spinners. */
+    volatile bool boosted;      /* Set by main after the boost. */
+    int checked_in;             /* Spinners run since the boost. */
+    uint64_t end;               /* TSC when the last one checked in. */
+    struct semaphore all_in;    /* Upped by the last to check in. */
+    struct semaphore release;   /* Upped by main to let spinners exit. */
+    struct semaphore done;      /* Upped by each spinner on exit. */
+  };
+
+static thread_func spinner_func;
+static void run_round (int thread_cnt);
+
+void
+test_bench_boost (void) 
+{
+  int saved_interval = mlfq_boost_interval;
+
+  ASSERT (thread_mlfqs);
+
+  mlfq_boost_interval = 0;
+  run_round (1);
+  run_round (10);
+  run_round (100);
+  mlfq_boost_interval = saved_interval;
+}
+
+static void
+run_round (int thread_cnt) 
+{
+  struct boost_round r;
+  enum intr_level old_level;
+  uint64_t start, cycles;
+  int i;
+
+  r.thread_cnt = thread_cnt;
+  r.boosted = false;
+  r.checked_in = 0;
+  sema_init (&r.all_in, 0);
+  sema_init (&r.release, 0);
+  sema_init (&r.done, 0);
+  for (i = 0; i < thread_cnt; i++)
+    if (thread_create ("spinner", PRI_DEFAULT, spinner_func, &r)
+        == TID_ERROR)
+      fail ("thread_create failed after %d threads", i);
+
+  timer_sleep (SINK_TICKS);
+
+  old_level = intr_disable ();
+  start = rdtsc ();
+  thread_mlfq_boost ();
+  cycles = rdtsc () - start;
+
+  /* Blocking with interrupts still off dispatches the spinners
+     straight away, one after another. */
+  r.boosted = true;
+  sema_down (&r.all_in);
+  intr_set_level (old_level);
+
+  for (i = 0; i < thread_cnt; i++)
+    sema_up (&r.release);
+  for (i = 0; i < thread_cnt; i++)
+    sema_down (&r.done);
+
+  msg ("bench boost: %d threads, %llu cycles, first round %llu cycles",
+       thread_cnt, cycles, r.end - start);
+}
+
+static void 
+spinner_func (void *r_) 
+{
+  struct boost_round *r = r_;
+  enum intr_level old_level;
+
+  while (!r->boosted)
+    continue;
+
+  old_level = intr_disable ();
+  if (++r->checked_in == r->thread_cnt)
+    {
+      r->end = rdtsc ();
+      sema_up (&r->all_in);
+    }
+  intr_set_level (old_level);
+
+  sema_down (&r->release);
+  sema_up (&r->done);
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+foreach my $cnt (1, 10, 100) {
+    fail "missing bench boost line for $cnt threads\n"
+      if !grep (/^\(bench-boost\) bench boost: $cnt threads, \d+ cycles, first round \d+ cycles$/,
+		@output);
+}
+pass;
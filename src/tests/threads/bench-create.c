@@ -0,0 +1,76 @@
+/* Measures thread_create() and thread_exit() throughput.  The
+   main thread creates short-lived children one at a time, waiting
+   for each to exit before creating the next, then creates them in
+   batches with thread_create_batch().  Both report the average
+   number of TSC cycles from creation to exit per thread, which
+   includes the switches to and from the child.
+
+   The results are printed as "bench" lines for scripts to pick
+   up; there are no expected values. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/tsc.h"
+
+#define THREAD_CNT 1000
+#define BATCH_CNT 32
+
+static thread_func child_func;
+
+void
+test_bench_create (void) 
+{
+  struct semaphore done;
+  uint64_t start, cycles;
+  int created;
+  int i;
+
+  sema_init (&done, 0);
+
+  /* One at a time. */
+  start = rdtsc ();
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      if (thread_create ("child", PRI_DEFAULT, child_func, &done)
+          == TID_ERROR)
+        fail ("thread_create failed after %d threads", i);
+      sema_down (&done);
+    }
+  cycles = rdtsc () - start;
+  msg ("bench create: %d threads, %llu cycles/thread",
+       THREAD_CNT, cycles / THREAD_CNT);
+
+  /* BATCH_CNT at a time.  All of the children share DONE, so the
+     aux pointers are all the same. */
+  {
+    void *aux[BATCH_CNT];
+
+    for (i = 0; i < BATCH_CNT; i++)
+      aux[i] = &done;
+
+    created = 0;
+    start = rdtsc ();
+    while (created < THREAD_CNT) 
+      {
+        if (thread_create_batch (BATCH_CNT, "child %d", PRI_DEFAULT,
+                                 child_func, aux) == TID_ERROR)
+          fail ("thread_create_batch failed after %d threads", created);
+        for (i = 0; i < BATCH_CNT; i++)
+          sema_down (&done);
+        created += BATCH_CNT;
+      }
+    cycles = rdtsc () - start;
+    msg ("bench create-batch: %d threads, %llu cycles/thread",
+         created, cycles / created);
+  }
+}
+
+static void 
+child_func (void *done_) 
+{
+  struct semaphore *done = done_;
+
+  sema_up (done);
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+foreach my $kind ("create", "create-batch") {
+    fail "missing bench $kind line\n"
+      if !grep (/^\(bench-create\) bench $kind: \d+ threads, \d+ cycles\/thread$/,
+		@output);
+}
+pass;
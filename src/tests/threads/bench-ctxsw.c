@@ -0,0 +1,162 @@
+/* Measures the cost of a context switch, and how much the layout
+   of struct thread matters to it.
+
+   First the main thread and a partner thread hand control back
+   and forth through a pair of semaphores, so every round is two
+   switches.  Then RING_CNT threads pass a turn around a ring of
+   semaphores, one switch per hand-off.  Each switch reads the
+   scheduler's hot members of struct thread for both threads.
+   Two threads stay in the cache, but every struct thread is
+   page-aligned, so their hot members all map to the same cache
+   sets, and a ring that is longer than the cache's associativity
+   evicts each one before its turn comes round again.  The ring
+   is therefore where the number of cache lines the hot members
+   span shows up.
+
+   The test reports the average number of TSC cycles per switch
+   for each, and which layout the kernel was built with.  Build
+   once as is and once with THREAD_SPREAD_LAYOUT defined (see
+   thread.h) to compare the packed layout with the old one.
+
+   The results are printed as "bench" lines for scripts to pick
+   up; there are no expected values. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/tsc.h"
+
+#define ROUND_CNT 10000
+
+/* Threads in the ring, counting the main thread, and times the
+   turn goes round it. */
+#define RING_CNT 32
+#define RING_ROUNDS 1000
+
+struct ping_pong
+  {
+    struct semaphore ping;      /* Upped by main, downed by partner. */
+    struct semaphore pong;      /* Upped by partner, downed by main. */
+    struct semaphore done;      /* Upped when the partner finishes. */
+  };
+
+struct ring
+  {
+    struct semaphore turn[RING_CNT];    /* Upped to pass thread I the turn. */
+    struct semaphore done;      /* Upped by each member as it finishes. */
+  };
+
+static struct ring ring;
+
+static thread_func partner_func;
+static thread_func ring_func;
+static void bench_ping_pong (void);
+static void bench_ring (void);
+
+void
+test_bench_ctxsw (void)
+{
+#ifdef THREAD_SPREAD_LAYOUT
+  const char *layout = "spread";
+#else
+  const char *layout = "packed";
+#endif
+
+  bench_ping_pong ();
+  bench_ring ();
+  msg ("bench ctxsw: %s layout, hot members in %d cache lines",
+       layout, (int) THREAD_HOT_LINES);
+}
+
+static void
+bench_ping_pong (void)
+{
+  struct ping_pong pp;
+  uint64_t start, cycles;
+  int i;
+
+  sema_init (&pp.ping, 0);
+  sema_init (&pp.pong, 0);
+  sema_init (&pp.done, 0);
+  thread_create ("partner", PRI_DEFAULT, partner_func, &pp);
+
+  /* Let the partner start and block on PING first. */
+  sema_up (&pp.ping);
+  sema_down (&pp.pong);
+
+  start = rdtsc ();
+  for (i = 0; i < ROUND_CNT; i++)
+    {
+      sema_up (&pp.ping);
+      sema_down (&pp.pong);
+    }
+  cycles = rdtsc () - start;
+  sema_down (&pp.done);
+
+  msg ("bench ctxsw: 2 threads, %d switches, %llu cycles/switch",
+       2 * ROUND_CNT, cycles / (2 * ROUND_CNT));
+}
+
+static void
+partner_func (void *pp_)
+{
+  struct ping_pong *pp = pp_;
+  int i;
+
+  for (i = 0; i <= ROUND_CNT; i++)
+    {
+      sema_down (&pp->ping);
+      sema_up (&pp->pong);
+    }
+  sema_up (&pp->done);
+}
+
+/* The main thread is member 0 of the ring. */
+static void
+bench_ring (void)
+{
+  uint64_t start, cycles;
+  int i;
+
+  for (i = 0; i < RING_CNT; i++)
+    sema_init (&ring.turn[i], 0);
+  sema_init (&ring.done, 0);
+  for (i = 1; i < RING_CNT; i++)
+    if (thread_create ("ring", PRI_DEFAULT, ring_func, (void *) i)
+        == TID_ERROR)
+      fail ("thread_create failed after %d threads", i - 1);
+
+  /* Pass the turn round once untimed, so that every member has
+     started and blocked on its semaphore. */
+  sema_up (&ring.turn[1]);
+  sema_down (&ring.turn[0]);
+
+  start = rdtsc ();
+  for (i = 0; i < RING_ROUNDS; i++)
+    {
+      sema_up (&ring.turn[1]);
+      sema_down (&ring.turn[0]);
+    }
+  cycles = rdtsc () - start;
+  for (i = 1; i < RING_CNT; i++)
+    sema_down (&ring.done);
+
+  msg ("bench ctxsw: %d threads, %d switches, %llu cycles/switch",
+       RING_CNT, RING_CNT * RING_ROUNDS,
+       cycles / (RING_CNT * RING_ROUNDS));
+}
+
+static void
+ring_func (void *aux)
+{
+  int id = (int) aux;
+  int i;
+
+  for (i = 0; i <= RING_ROUNDS; i++)
+    {
+      sema_down (&ring.turn[id]);
+      sema_up (&ring.turn[(id + 1) % RING_CNT]);
+    }
+  sema_up (&ring.done);
+}
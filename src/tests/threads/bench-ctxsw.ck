@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+foreach my $cnt (2, 32) {
+    fail "missing bench ctxsw line for $cnt threads\n"
+      if !grep (/^\(bench-ctxsw\) bench ctxsw: $cnt threads, \d+ switches, \d+ cycles\/switch$/,
+		@output);
+}
+fail "missing bench ctxsw layout line\n"
+  if !grep (/^\(bench-ctxsw\) bench ctxsw: (packed|spread) layout, hot members in \d+ cache lines$/,
+	    @output);
+pass;
@@ -0,0 +1,94 @@
+/* Measures dispatch latency at each MLFQ level: the TSC cycles
+   from the main thread's sema_up() to the woken thread running.
+   The woken thread spins for a tick between rounds, so it sinks
+   one level per quantum and collects samples at every level on
+   its way down to the bottom queue.  The main thread blocks
+   right after each sema_up(), so a woken thread below it is
+   dispatched by that block and one above it by preemption.
+
+   The periodic boost is turned off while the test runs so that
+   it does not reset the thread.  The results are printed as one
+   "bench" line per level for scripts to pick up; there are no
+   expected values. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "devices/timer.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/tsc.h"
+
+/* Samples to take at the bottom level before stopping. */
+#define BOTTOM_SAMPLES 20
+
+struct dispatch_state
+  {
+    struct semaphore go;        /* Upped by main, downed by the thread. */
+    struct semaphore ack;       /* Upped by the thread, downed by main. */
+    uint64_t start;             /* TSC just before main's sema_up(). */
+    bool done;                  /* Set by the thread when finished. */
+    uint64_t cycles[MLFQ_NUM_QUEUES];   /* Total latency per level. */
+    int samples[MLFQ_NUM_QUEUES];       /* Samples per level. */
+  };
+
+static struct dispatch_state ds;
+
+static thread_func sinker_func;
+
+void
+test_bench_dispatch (void) 
+{
+  int saved_interval = mlfq_boost_interval;
+  int level;
+
+  ASSERT (thread_mlfqs);
+
+  mlfq_boost_interval = 0;
+  sema_init (&ds.go, 0);
+  sema_init (&ds.ack, 0);
+  thread_create ("sinker", PRI_DEFAULT, sinker_func, NULL);
+
+  sema_down (&ds.ack);
+  while (!ds.done) 
+    {
+      ds.start = rdtsc ();
+      sema_up (&ds.go);
+      sema_down (&ds.ack);
+    }
+  mlfq_boost_interval = saved_interval;
+
+  for (level = MLFQ_PRIORITY_MAX; level >= MLFQ_PRIORITY_MIN; level--)
+    if (ds.samples[level] > 0)
+      msg ("bench dispatch: level %d, %d samples, %llu cycles",
+           level, ds.samples[level], ds.cycles[level] / ds.samples[level]);
+}
+
+static void 
+sinker_func (void *aux UNUSED) 
+{
+  for (;;) 
+    {
+      uint64_t now;
+      int64_t tick;
+      int level;
+
+      sema_up (&ds.ack);
+      sema_down (&ds.go);
+      now = rdtsc ();
+      level = thread_get_priority ();
+      ds.cycles[level] += now - ds.start;
+      ds.samples[level]++;
+
+      if (level == MLFQ_PRIORITY_MIN
+          && ds.samples[level] >= BOTTOM_SAMPLES)
+        break;
+
+      /* Use up a tick of the quantum. */
+      tick = timer_ticks ();
+      while (timer_ticks () == tick)
+        continue;
+    }
+
+  ds.done = true;
+  sema_up (&ds.ack);
+}
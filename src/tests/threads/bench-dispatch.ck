@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+foreach my $level (19, 0) {
+    fail "missing bench dispatch line for level $level\n"
+      if !grep (/^\(bench-dispatch\) bench dispatch: level $level, \d+ samples, \d+ cycles$/,
+		@output);
+}
+pass;
@@ -0,0 +1,89 @@
+/* Measures timer_sleep() wakeup jitter.  For each of 1, 100 and
+   1000 sleepers, every sleeper sleeps until the same tick, and
+   the test reports how many ticks late the last of them woke and
+   the TSC cycles between the first and the last wakeup.
+
+   The kernel thread pool may not fit 1000 threads, in which case
+   that round uses as many as could be created, and says so in
+   its "bench" line.  There are no expected values. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/tsc.h"
+
+struct sleep_round
+  {
+    int64_t wake_tick;          /* Tick every sleeper sleeps until. */
+    int64_t max_late;           /* Most ticks late of any sleeper. */
+    uint64_t first_tsc;         /* TSC at the first wakeup. */
+    uint64_t last_tsc;          /* TSC at the last wakeup. */
+    int woken;                  /* Sleepers that have woken. */
+    struct semaphore done;      /* Upped by each sleeper on exit. */
+  };
+
+static thread_func sleeper_func;
+static void run_round (int sleeper_cnt);
+
+void
+test_bench_sleep (void) 
+{
+  run_round (1);
+  run_round (100);
+  run_round (1000);
+}
+
+static void
+run_round (int sleeper_cnt) 
+{
+  struct sleep_round r;
+  int created;
+  int i;
+
+  /* Leave enough time to create every sleeper before the
+     deadline: well under a tick per thread. */
+  r.wake_tick = timer_ticks () + 10 + sleeper_cnt / 10;
+  r.max_late = 0;
+  r.first_tsc = r.last_tsc = 0;
+  r.woken = 0;
+  sema_init (&r.done, 0);
+
+  for (created = 0; created < sleeper_cnt; created++)
+    if (thread_create ("sleeper", PRI_DEFAULT, sleeper_func, &r)
+        == TID_ERROR)
+      break;
+  if (created == 0)
+    fail ("could not create any sleepers");
+
+  for (i = 0; i < created; i++)
+    sema_down (&r.done);
+
+  msg ("bench sleep: %d sleepers, %lld ticks late, %llu cycles spread",
+       created, r.max_late, r.last_tsc - r.first_tsc);
+}
+
+static void 
+sleeper_func (void *r_) 
+{
+  struct sleep_round *r = r_;
+  enum intr_level old_level;
+  uint64_t now;
+  int64_t late;
+
+  timer_sleep (r->wake_tick - timer_ticks ());
+
+  old_level = intr_disable ();
+  now = rdtsc ();
+  late = timer_ticks () - r->wake_tick;
+  if (r->woken++ == 0)
+    r->first_tsc = now;
+  r->last_tsc = now;
+  if (late > r->max_late)
+    r->max_late = late;
+  intr_set_level (old_level);
+
+  sema_up (&r->done);
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+my (@lines) = grep (/^\(bench-sleep\) bench sleep: \d+ sleepers, -?\d+ ticks late, \d+ cycles spread$/,
+		     @output);
+fail "expected 3 bench sleep lines, got " . scalar (@lines) . "\n"
+  if @lines != 3;
+pass;
@@ -0,0 +1,79 @@
+/* Checks that adaptive boosting with a boost interval of 0 never
+   boosts.  Two CPU-bound threads spin side by side, so that one
+   of them always waits in a ready queue while the other runs,
+   and each notes whether its MLFQ priority ever rises again once
+   it has reached the bottom queue.  Neither may: an interval of
+   0 means no boost, adaptive or periodic. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "devices/timer.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Ticks each spinner runs for.  Sinking from the top queue to the
+   bottom one takes 210 ticks of CPU time. */
+#define SPIN_TICKS 1000
+#define THREAD_CNT 2
+
+struct spinner
+  {
+    bool reached_bottom;        /* Ran at MLFQ_PRIORITY_MIN. */
+    bool rose;                  /* Ran above it afterward. */
+    struct semaphore *done;     /* Upped on exit. */
+  };
+
+static thread_func spinner_func;
+
+void
+test_mlfqs2_adaptive_never (void) 
+{
+  bool saved_adaptive = mlfq_adaptive_boost;
+  int saved_interval = mlfq_boost_interval;
+  struct spinner spinners[THREAD_CNT];
+  struct semaphore done;
+  int i;
+
+  ASSERT (thread_mlfqs);
+
+  mlfq_adaptive_boost = true;
+  mlfq_boost_interval = 0;
+
+  sema_init (&done, 0);
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      spinners[i].reached_bottom = spinners[i].rose = false;
+      spinners[i].done = &done;
+      thread_create ("spinner", PRI_DEFAULT, spinner_func, &spinners[i]);
+    }
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+
+  mlfq_adaptive_boost = saved_adaptive;
+  mlfq_boost_interval = saved_interval;
+
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      if (!spinners[i].reached_bottom)
+        fail ("spinner %d never reached the bottom queue", i);
+      if (spinners[i].rose)
+        fail ("spinner %d was boosted", i);
+    }
+  msg ("no spinner was boosted");
+}
+
+static void 
+spinner_func (void *s_) 
+{
+  struct spinner *s = s_;
+  int64_t start = timer_ticks ();
+
+  while (timer_elapsed (start) < SPIN_TICKS)
+    {
+      if (thread_get_priority () == MLFQ_PRIORITY_MIN)
+        s->reached_bottom = true;
+      else if (s->reached_bottom)
+        s->rose = true;
+    }
+  sema_up (s->done);
+}
@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(mlfqs2-adaptive-never) begin
+(mlfqs2-adaptive-never) no spinner was boosted
+(mlfqs2-adaptive-never) end
+EOF
+pass;
@@ -0,0 +1,157 @@
+/* Checks that a thread queued at a level only by donation does
+   not hold back maxwait promotion of the threads behind it.
+
+   A holder sinks to level 17 and takes a lock; a waiter at level
+   18 then blocks on that lock, donating level 18 to it.  The
+   holder is made ready at the front of queue 18, with a thread
+   whose own priority is 18 right behind it, and the main thread,
+   running in the real-time class, keeps both of them from running
+   for several times level 18's maxwait.  The thread behind the
+   holder must be moved up to level 19 all the same.
+
+   Levels 17 and 18 are made to keep their threads, and level 19
+   to send them to the level being set up, so that the threads
+   land where the test needs them. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "devices/timer.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Level 18's maxwait, and how long the main thread keeps the
+   two ready threads waiting. */
+#define MAXWAIT 5
+#define STARVE_TICKS (4 * MAXWAIT)
+
+static struct lock lock;
+static struct semaphore holder_go, starver_go, done;
+static struct thread *volatile holder, *volatile waiter, *volatile starver;
+
+static thread_func holder_func, waiter_func, starver_func;
+static void sink_to (int level);
+static void wait_blocked (struct thread *volatile *);
+static void set_table (const char *);
+
+void
+test_mlfqs2_donated_head (void)
+{
+  struct mlfq_dispatch saved[MLFQ_NUM_QUEUES];
+  bool saved_adaptive = mlfq_adaptive_boost;
+  int saved_interval = mlfq_boost_interval;
+  int saved_rt_share = rt_share;
+  char table[128];
+  int64_t start;
+  int i;
+
+  ASSERT (thread_mlfqs);
+
+  for (i = 0; i < MLFQ_NUM_QUEUES; i++)
+    saved[i] = mlfq_dispatch_table[i];
+  mlfq_adaptive_boost = false;
+  mlfq_boost_interval = 0;
+  rt_share = 100;
+  thread_set_sched (SCHED_FIFO, RT_PRIORITY_MIN);
+
+  lock_init (&lock);
+  sema_init (&holder_go, 0);
+  sema_init (&starver_go, 0);
+  sema_init (&done, 0);
+
+  /* The holder sinks to 17, takes the lock and blocks. */
+  set_table ("19:1:17:19:0,18:1000:18:18:0,17:1000:17:17:0");
+  thread_create ("holder", PRI_DEFAULT, holder_func, NULL);
+  wait_blocked (&holder);
+
+  /* The waiter and the starver sink to 18; the waiter blocks on
+     the lock, the starver on a semaphore. */
+  set_table ("19:1:18:19:0");
+  thread_create ("waiter", PRI_DEFAULT, waiter_func, NULL);
+  wait_blocked (&waiter);
+  thread_create ("starver", PRI_DEFAULT, starver_func, NULL);
+  wait_blocked (&starver);
+
+  /* Queue the holder, by donation, in front of the starver. */
+  snprintf (table, sizeof table, "18:1000:18:18:%d", MAXWAIT);
+  set_table (table);
+  sema_up (&holder_go);
+  sema_up (&starver_go);
+
+  start = timer_ticks ();
+  while (timer_elapsed (start) < STARVE_TICKS)
+    continue;
+  if (starver->mlfq_priority != MLFQ_PRIORITY_MAX)
+    fail ("starver still at level %d after %d ticks behind a donated "
+          "holder", starver->mlfq_priority, STARVE_TICKS);
+
+  thread_set_sched (SCHED_OTHER, 0);
+  for (i = 0; i < 3; i++)
+    sema_down (&done);
+
+  snprintf (table, sizeof table, "17:%d:%d:%d:%d,18:%d:%d:%d:%d,"
+            "19:%d:%d:%d:%d",
+            saved[17].quantum, saved[17].tqexp, saved[17].slpret,
+            saved[17].maxwait, saved[18].quantum, saved[18].tqexp,
+            saved[18].slpret, saved[18].maxwait, saved[19].quantum,
+            saved[19].tqexp, saved[19].slpret, saved[19].maxwait);
+  set_table (table);
+  rt_share = saved_rt_share;
+  mlfq_boost_interval = saved_interval;
+  mlfq_adaptive_boost = saved_adaptive;
+
+  msg ("starver promoted past a donated holder");
+}
+
+static void
+holder_func (void *aux UNUSED)
+{
+  sink_to (17);
+  lock_acquire (&lock);
+  holder = thread_current ();
+  sema_down (&holder_go);
+  lock_release (&lock);
+  sema_up (&done);
+}
+
+static void
+waiter_func (void *aux UNUSED)
+{
+  sink_to (18);
+  waiter = thread_current ();
+  lock_acquire (&lock);
+  lock_release (&lock);
+  sema_up (&done);
+}
+
+static void
+starver_func (void *aux UNUSED)
+{
+  sink_to (18);
+  starver = thread_current ();
+  sema_down (&starver_go);
+  sema_up (&done);
+}
+
+/* Spins until the running thread is at LEVEL. */
+static void
+sink_to (int level)
+{
+  while (thread_get_priority () != level)
+    continue;
+}
+
+/* Sleeps a tick at a time until *T names a blocked thread. */
+static void
+wait_blocked (struct thread *volatile *t)
+{
+  while (*t == NULL || (*t)->status != THREAD_BLOCKED)
+    timer_sleep (1);
+}
+
+/* Sets dispatch table entries from TABLE, as -mlfqs-table does. */
+static void
+set_table (const char *table)
+{
+  if (!thread_mlfq_parse_table (table))
+    fail ("bad dispatch table \"%s\"", table);
+}
@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(mlfqs2-donated-head) begin
+(mlfqs2-donated-head) starver promoted past a donated holder
+(mlfqs2-donated-head) end
+EOF
+pass;
@@ -45,6 +45,13 @@ static const struct test tests[] =
     {"mlfqs2-priority-order", test_mlfqs2_priority_order},
     {"mlfqs2-preempt", test_mlfqs2_preempt},
     {"mlfqs2-mass", test_mlfqs2_mass},
+    {"mlfqs2-adaptive-never", test_mlfqs2_adaptive_never},
+    {"mlfqs2-donated-head", test_mlfqs2_donated_head},
+    {"bench-ctxsw", test_bench_ctxsw},
+    {"bench-create", test_bench_create},
+    {"bench-sleep", test_bench_sleep},
+    {"bench-boost", test_bench_boost},
+    {"bench-dispatch", test_bench_dispatch},
   };
 
 static const char *test_name;
@@ -39,6 +39,13 @@ void test_mlfqs2_boost(void);
 void test_mlfqs2_priority_order(void);
 void test_mlfqs2_preemt(void);
 void test_mlfqs2_mass(void);
+extern test_func test_mlfqs2_adaptive_never;
+extern test_func test_mlfqs2_donated_head;
+extern test_func test_bench_ctxsw;
+extern test_func test_bench_create;
+extern test_func test_bench_sleep;
+extern test_func test_bench_boost;
+extern test_func test_bench_dispatch;
 
 void msg (const char *, ...);
 void fail (const char *, ...);
@@ -0,0 +1,66 @@
+#ifndef THREADS_HISTOGRAM_H
+#define THREADS_HISTOGRAM_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* A log2-bucketed histogram of non-negative integer samples.
+   Bucket 0 counts samples of 0, bucket B > 0 counts samples in
+   [2**(B-1), 2**B - 1], and the last bucket also takes every
+   larger sample, so tails stay visible without a large table. */
+#define HISTOGRAM_BUCKETS 16
+
+struct histogram
+  {
+    unsigned count[HISTOGRAM_BUCKETS];
+  };
+
+/* Adds VALUE to histogram H.  Negative values count as 0. */
+static inline void
+histogram_add (struct histogram *h, int64_t value)
+{
+  int b = 0;
+
+  while (value > 0 && b < HISTOGRAM_BUCKETS - 1)
+    {
+      value >>= 1;
+      b++;
+    }
+  h->count[b]++;
+}
+
+/* Returns the total number of samples in H. */
+static inline unsigned
+histogram_total (const struct histogram *h)
+{
+  unsigned total = 0;
+  int b;
+
+  for (b = 0; b < HISTOGRAM_BUCKETS; b++)
+    total += h->count[b];
+  return total;
+}
+
+/* Prints H on one line after PREFIX, as a list of "LO-HI:COUNT"
+   entries for its non-empty buckets. */
+static inline void
+histogram_print (const char *prefix, const struct histogram *h)
+{
+  int b;
+
+  printf ("%s", prefix);
+  for (b = 0; b < HISTOGRAM_BUCKETS; b++)
+    if (h->count[b] != 0)
+      {
+        long long lo = b == 0 ? 0 : 1LL << (b - 1);
+        long long hi = b == 0 ? 0 : (1LL << b) - 1;
+
+        if (b == HISTOGRAM_BUCKETS - 1)
+          printf (" %lld+:%u", lo, h->count[b]);
+        else
+          printf (" %lld-%lld:%u", lo, hi, h->count[b]);
+      }
+  printf ("\n");
+}
+
+#endif /* threads/histogram.h */
@@ -0,0 +1,76 @@
+#ifndef THREADS_INTR_PROFILE_H
+#define THREADS_INTR_PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+#include "threads/tsc.h"
+
+/* Interrupts-off profiler.
+
+   With INTR_PROFILE defined (see threads/thread.h), call sites
+   that use INTR_PROFILE_DISABLE() and INTR_PROFILE_SET_LEVEL()
+   in place of intr_disable() and intr_set_level() have the time
+   from the disable to the matching enable measured with the TSC.
+   Only the outermost section counts: a disable with interrupts
+   already off is not a new window.  A window that is still open
+   when schedule() switches threads is closed there, so the time
+   another thread spends running is not charged to the site.
+
+   Code that already runs with interrupts off, such as the timer
+   interrupt handler, can time a stretch of work with
+   INTR_PROFILE_SPAN_BEGIN() and INTR_PROFILE_SPAN_END().
+
+   thread_print_stats() reports the sites with the longest
+   windows at shutdown.  Without INTR_PROFILE the macros are the
+   plain interrupt calls. */
+
+/* One profiled call site. */
+struct intr_profile_site
+  {
+    const char *function;       /* Function containing the site. */
+    int line;                   /* Source line of the site. */
+    bool registered;            /* On the list of sites yet? */
+    struct intr_profile_site *next; /* Next site on the list. */
+    unsigned count;             /* Number of windows measured. */
+    uint64_t total_cycles;      /* Sum of their lengths. */
+    uint64_t max_cycles;        /* Longest of them. */
+  };
+
+#ifdef INTR_PROFILE
+void intr_profile_begin (struct intr_profile_site *);
+void intr_profile_end (void);
+void intr_profile_record (struct intr_profile_site *, uint64_t cycles);
+void intr_profile_print (void);
+
+#define INTR_PROFILE_DISABLE()                                          \
+  ({                                                                    \
+    static struct intr_profile_site intr_site_ = { __func__, __LINE__ }; \
+    enum intr_level intr_old_ = intr_disable ();                        \
+    if (intr_old_ == INTR_ON)                                           \
+      intr_profile_begin (&intr_site_);                                 \
+    intr_old_;                                                          \
+  })
+#define INTR_PROFILE_SET_LEVEL(OLD)                                     \
+  ({                                                                    \
+    if ((OLD) == INTR_ON)                                               \
+      intr_profile_end ();                                              \
+    intr_set_level (OLD);                                               \
+  })
+#define INTR_PROFILE_SPAN_BEGIN(VAR) uint64_t VAR = rdtsc ()
+#define INTR_PROFILE_SPAN_END(VAR)                                      \
+  do                                                                    \
+    {                                                                   \
+      static struct intr_profile_site intr_site_ = { __func__, __LINE__ }; \
+      intr_profile_record (&intr_site_, rdtsc () - (VAR));              \
+    }                                                                   \
+  while (0)
+#else
+#define INTR_PROFILE_DISABLE() intr_disable ()
+#define INTR_PROFILE_SET_LEVEL(OLD) intr_set_level (OLD)
+#define INTR_PROFILE_SPAN_BEGIN(VAR) ((void) 0)
+#define INTR_PROFILE_SPAN_END(VAR) ((void) 0)
+#endif
+
+#endif /* threads/intr-profile.h */
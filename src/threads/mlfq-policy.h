@@ -0,0 +1,194 @@
+#ifndef THREADS_MLFQ_POLICY_H
+#define THREADS_MLFQ_POLICY_H
+
+/* The MLFQ scheduling policy, apart from the run queues, locking
+   and interrupts that carry it out.  Everything here is pure
+   arithmetic on a thread's MLFQ state and the dispatch table, so
+   that the kernel (thread.c, timer.c) and the host-side
+   simulator (utils/mlfq-sim.c) make exactly the same decisions.
+   Nothing here may include a kernel-only header. */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/fixed-point.h"
+
+#define MLFQ_PRIORITY_MAX 19            /* highest MLFQ priority (queue 19). */
+#define MLFQ_PRIORITY_MIN 0             /* lowest MLFQ priority (queue 0). */
+#define MLFQ_NUM_QUEUES 20              /* total number of priority queues. */
+#define MLFQ_BOOST_INTERVAL 50          /* boost all threads every 50 ticks. */
+#define MLFQ_SLEEP_CREDIT_MAX 3         /* most levels one wakeup can earn. */
+
+/* One level of the MLFQ dispatch table, after the Solaris
+   time-sharing class's ts_dptbl.  The compiled-in default gives
+   level L a quantum of MLFQ_PRIORITY_MAX - L + 1 ticks, moves a
+   thread down one level when it uses that up, returns sleepers to
+   the level they slept at, and leaves starvation to the periodic
+   boost.  The kernel command-line option -mlfqs-table overrides
+   entries (see thread_mlfq_parse_table()). */
+struct mlfq_dispatch
+  {
+    int quantum;                /* Ticks a thread may run at this level. */
+    int tqexp;                  /* Level after using up the quantum. */
+    int slpret;                 /* Level on return from timer_sleep(). */
+    int maxwait;                /* Ticks ready without running before the
+                                   thread moves up a level, or 0 for never. */
+  };
+
+/* Initializer for level L of the default dispatch table. */
+#define MLFQ_DEFAULT_DISPATCH(L)                                        \
+  { MLFQ_PRIORITY_MAX - (L) + 1,                                        \
+    (L) > MLFQ_PRIORITY_MIN ? (L) - 1 : MLFQ_PRIORITY_MIN, (L), 0 }
+
+/* Returns the highest level set in READY_MASK, in which bit I
+   means level I has a ready thread.  READY_MASK must not be 0. */
+static inline int
+mlfq_policy_pick (uint32_t ready_mask)
+{
+  return 31 - __builtin_clz (ready_mask);
+}
+
+/* Returns which of CPU_CNT run queues, whose ready masks are
+   READY_MASKS, an idle CPU SELF should steal from: the other one
+   whose highest non-empty queue is highest, or -1 if all the
+   others have nothing ready either.  Comparing masks directly
+   ranks them by their highest non-empty queue.  The thief takes
+   the first thread of that queue. */
+static inline int
+mlfq_policy_steal_victim (const uint32_t *ready_masks, int cpu_cnt, int self)
+{
+  uint32_t best = 0;
+  int victim = -1;
+  int cpu;
+
+  for (cpu = 0; cpu < cpu_cnt; cpu++)
+    if (cpu != self && ready_masks[cpu] > best)
+      {
+        victim = cpu;
+        best = ready_masks[cpu];
+      }
+  return victim;
+}
+
+/* Charges one tick to a thread running at *PRIORITY that has
+   used *TICKS of its quantum there.  If that uses up the
+   quantum, moves it to TABLE's tqexp level with a fresh quantum
+   and returns true; otherwise returns false. */
+static inline bool
+mlfq_policy_charge (const struct mlfq_dispatch *table,
+                    int *priority, int *ticks)
+{
+  if (++*ticks < table[*priority].quantum)
+    return false;
+  *priority = table[*priority].tqexp;
+  *ticks = 0;
+  return true;
+}
+
+/* Brings a thread's MLFQ state up to date with boost EPOCH: if
+   *THREAD_EPOCH is older, moves it to the top level with a fresh
+   quantum and returns true; otherwise returns false. */
+static inline bool
+mlfq_policy_apply_boost (unsigned epoch, int *priority, int *ticks,
+                         unsigned *thread_epoch)
+{
+  if (*thread_epoch == epoch)
+    return false;
+  *priority = MLFQ_PRIORITY_MAX;
+  *ticks = 0;
+  *thread_epoch = epoch;
+  return true;
+}
+
+/* Returns the level that a thread leaving timer_sleep() at LEVEL
+   moves up to with sleep credit, having slept SLEPT ticks after
+   running RAN: one level per multiple of RAN + 1 slept, up to
+   MLFQ_SLEEP_CREDIT_MAX levels.  A sleep shorter than LEVEL's
+   quantum earns nothing, so that a thread cannot keep its place
+   by sleeping for a tick just before its quantum runs out. */
+static inline int
+mlfq_policy_sleep_credit (const struct mlfq_dispatch *table, int level,
+                          int64_t slept, int ran)
+{
+  int64_t credit;
+
+  if (slept < table[level].quantum)
+    return level;
+  credit = slept / (ran + 1);
+  if (credit > MLFQ_SLEEP_CREDIT_MAX)
+    credit = MLFQ_SLEEP_CREDIT_MAX;
+  return (level + credit > MLFQ_PRIORITY_MAX
+          ? MLFQ_PRIORITY_MAX : level + credit);
+}
+
+/* Returns the quantum ticks a thread that slept at SAVED_LEVEL
+   having used SAVED_TICKS there keeps on waking at LEVEL: all of
+   them at the same level, none at a new one. */
+static inline int
+mlfq_policy_wake_ticks (int saved_level, int saved_ticks, int level)
+{
+  return level == saved_level ? saved_ticks : 0;
+}
+
+/* Returns LOAD_AVG, a once-a-second exponentially weighted
+   moving average of the number of threads running or ready,
+   updated for READY such threads now. */
+static inline fixed_point
+mlfq_policy_load_avg (fixed_point load_avg, int ready)
+{
+  return (fp_mul (fp_div (fp_from_int (59), fp_from_int (60)), load_avg)
+          + fp_from_int (ready) / 60);
+}
+
+/* Returns the factor by which recent_cpu decays at the end of a
+   second after which the load average is LOAD_AVG:
+   (2 * LOAD_AVG) / (2 * LOAD_AVG + 1), always less than 1. */
+static inline fixed_point
+mlfq_policy_recent_cpu_decay (fixed_point load_avg)
+{
+  return fp_div (2 * load_avg, 2 * load_avg + FP_ONE);
+}
+
+/* Returns RECENT_CPU after SECONDS more seconds that each ended
+   with decay factor DECAY, for a thread of niceness NICE: each
+   second multiplies it by DECAY and adds NICE.  That sums to
+   DECAY^SECONDS * RECENT_CPU + NICE * (1 - DECAY^SECONDS) / (1 - DECAY),
+   so the cost grows only with the log of SECONDS. */
+static inline fixed_point
+mlfq_policy_recent_cpu (fixed_point recent_cpu, fixed_point decay, int nice,
+                        int64_t seconds)
+{
+  fixed_point power = FP_ONE;
+  fixed_point base = decay;
+
+  if (seconds == 1)
+    return fp_mul (decay, recent_cpu) + fp_from_int (nice);
+  for (; seconds > 0 && power != 0; seconds >>= 1)
+    {
+      if (seconds & 1)
+        power = fp_mul (power, base);
+      base = fp_mul (base, base);
+    }
+  return (fp_mul (power, recent_cpu)
+          + fp_mul (fp_from_int (nice),
+                    fp_div (FP_ONE - power, FP_ONE - decay)));
+}
+
+/* Returns the ticks that the head of a queue may wait before
+   adaptive boosting boosts its level: half of BOOST_INTERVAL
+   when idle, growing by half of it for each unit of LOAD_AVG,
+   and at least 1.  A BOOST_INTERVAL of 0 or less means never to
+   boost, so then no wait is long enough: INT64_MAX. */
+static inline int64_t
+mlfq_policy_starvation_threshold (int boost_interval, fixed_point load_avg)
+{
+  int64_t threshold;
+
+  if (boost_interval <= 0)
+    return INT64_MAX;
+  threshold = ((int64_t) boost_interval * (FP_ONE + load_avg)
+               / (2 * FP_ONE));
+
+  return threshold > 0 ? threshold : 1;
+}
+
+#endif /* threads/mlfq-policy.h */
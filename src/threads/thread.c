@@ -4,8 +4,13 @@
 #include <random.h>
 #include <stdio.h>
 #include <string.h>
+#include "devices/serial.h"
+#include "devices/timer.h"
+#include "threads/fixed-point.h"
 #include "threads/flags.h"
+#include "threads/histogram.h"
 #include "threads/interrupt.h"
+#include "threads/intr-profile.h"
 #include "threads/intr-stubs.h"
 #include "threads/palloc.h"
 #include "threads/switch.h"
@@ -20,30 +25,146 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
-
 /* ========================================================================== */
-/* ADDED FOR LAB 4: Array of 20 MLFQ priority queues                          */
-/* Each queue holds threads at that priority level (queue 0 = lowest priority,*/
-/* queue 19 = highest priority). We pick threads from highest queue first.   */
+/* The run queue.  Everything the dispatcher touches -- the ready list, the  */
+/* MLFQ queues and their bitmap, and the idle thread -- lives in one struct  */
+/* runqueue, reached through this_rq(), rather than in loose globals.        */
+/*                                                                            */
+/* Pintos only brings up the boot CPU, and intr_disable() is the only lock   */
+/* here, so the kernel has a single run queue.  The SMP policy -- one run    */
+/* queue per CPU, idle CPUs stealing through mlfq_policy_steal_victim(), and */
+/* each CPU splicing its own queues on a boost -- runs in the host-side      */
+/* simulator instead (mlfq-sim --cpus=N), until AP bring-up, per-CPU         */
+/* running_thread() and run-queue spinlocks exist here.                      */
 /* ========================================================================== */
-static struct list mlfq_queues[MLFQ_NUM_QUEUES];
+
+#if SCHED_NUM_LEVELS > 32
+#error mlfq_ready_mask holds at most 32 levels
+#endif
+
+/* Bits of mlfq_ready_mask that belong to MLFQ levels. */
+#define MLFQ_LEVELS_MASK ((1u << MLFQ_NUM_QUEUES) - 1)
+
+/* One scheduling group's share of a run queue. */
+struct group_queues
+  {
+    /* ADDED FOR LAB 4: Array of 20 MLFQ priority queues.
+       Each queue holds threads at that priority level (queue 0 =
+       lowest priority, queue 19 = highest priority). We pick
+       threads from highest queue first. */
+    struct list mlfq_queues[MLFQ_NUM_QUEUES];
+
+    /* Bit I is set iff mlfq_queues[I] is non-empty. */
+    uint32_t ready_mask;
+  };
+
+struct runqueue
+  {
+    /* List of processes in THREAD_READY state, that is, processes
+       that are ready to run but not actually running. */
+    struct list ready_list;
+
+    /* MLFQ queues of each scheduling group. */
+    struct group_queues groups[SCHED_GROUP_MAX];
+
+    /* Real-time queues, one per real-time priority, above every
+       MLFQ queue. */
+    struct list rt_queues[RT_PRIORITY_MAX + 1];
+
+    /* Ready-queue bitmap: bit I is set iff the queue for
+       scheduling level I, some group's mlfq_queues[I] or above
+       them rt_queues[I - RT_LEVEL_BASE], is non-empty.  This lets
+       next_thread_to_run() find the highest non-empty queue with
+       one find-highest-set-bit instead of scanning all of them. */
+    uint32_t mlfq_ready_mask;
+
+    /* Last boost epoch spliced into these queues. */
+    unsigned boost_epoch;
+
+    /* Pass of the group dispatched last, which a group that comes
+       back from having nothing ready starts from. */
+    int64_t group_pass;
+
+    /* Ticks run at real-time levels in the current second, and
+       whether that has used up rt_share of it. */
+    int rt_ticks;
+    bool rt_throttled;
+    int64_t rt_second;          /* The second they are counted for. */
+
+#ifdef SCHED_STATS
+    /* Number of threads in each scheduling level's queue. */
+    int mlfq_queue_len[SCHED_NUM_LEVELS];
+#endif
+
+    /* Idle thread. */
+    struct thread *idle_thread;
+  };
+
+static struct runqueue runqueue;
+
+/* A scheduling group.  Stride scheduling: each tick its threads
+   run at MLFQ levels advances its pass by its stride, which is
+   inversely proportional to its weight, and the dispatcher serves
+   the ready group with the lowest pass. */
+struct sched_group
+  {
+    char name[16];              /* Name (for debugging purposes). */
+    int weight;                 /* Share relative to the other groups. */
+    int64_t stride;             /* SCHED_STRIDE1 / weight. */
+    int64_t pass;               /* Virtual time the group has used. */
+    long long ticks;            /* Ticks its threads have run. */
+  };
+
+#define SCHED_STRIDE1 (1 << 20)         /* Stride of a group of weight 1. */
+
+/* Groups in use are sched_groups[0] to sched_groups[sched_group_cnt - 1]. */
+static struct sched_group sched_groups[SCHED_GROUP_MAX];
+static int sched_group_cnt;
 /* ========================================================================== */
 
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
 static struct list all_list;
 
-/* Idle thread. */
-static struct thread *idle_thread;
+/* Threads on all_list, and dying threads until their pages are
+   reclaimed, by status: each thread is on the list for its status
+   through its stateelem, so that thread_foreach_state() visits
+   only the threads in one state.  Interrupts off guard them. */
+#define THREAD_STATE_CNT (THREAD_DYING + 1)
+static struct list state_lists[THREAD_STATE_CNT];
+static int state_counts[THREAD_STATE_CNT];
 
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
 
-/* Lock used by allocate_tid(). */
-static struct lock tid_lock;
+/* Threads on all_list, hashed by tid for thread_find().  A
+   thread joins when it joins all_list and leaves in thread_exit(). */
+#define TID_BUCKETS 64          /* Must be a power of 2. */
+static struct list tid_buckets[TID_BUCKETS];
+
+/* ========================================================================== */
+/* Thread-page cache.  thread_schedule_tail() parks dying threads' pages on  */
+/* dirty_pages instead of freeing them, the idle thread zeroes them onto     */
+/* clean_pages, and thread_create() takes from clean_pages first, so short-  */
+/* lived threads rarely reach palloc.  Interrupts off guard both lists.      */
+/* ========================================================================== */
+#define THREAD_PAGE_CACHE_SIZE 16   /* Most pages kept on both lists. */
+
+/* A cached page.  The link lives at the start of the page, so a
+   clean page is all zeros except for these bytes. */
+struct cached_page
+  {
+    struct list_elem elem;
+  };
+
+static struct list clean_pages;     /* Zeroed, ready for thread_create(). */
+static struct list dirty_pages;     /* Freed, waiting for the idle thread. */
+static size_t page_cache_cnt;       /* Pages on both lists. */
+
+static long long page_cache_hits;         /* Got a clean page. */
+static long long page_cache_dirty_hits;   /* Had to zero a dirty page. */
+static long long page_cache_misses;       /* Fell back to palloc. */
+/* ========================================================================== */
 
 /* Stack frame for kernel_thread(). */
 struct kernel_thread_frame 
@@ -57,10 +178,64 @@ struct kernel_thread_frame
 static long long idle_ticks;    /* # of timer ticks spent idle. */
 static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
 static long long user_ticks;    /* # of timer ticks in user programs. */
+static long long context_switches; /* # of switches to a different thread. */
+static long long preemptions;   /* # of preemptions requested on a tick or wakeup. */
+
+/* True from request_preempt() until thread_yield() acts on it.  An
+   interrupt may also yield only to run deferred work (see
+   run_deferred_work()), which need not cost the thread its turn. */
+static bool preempt_requested;
+
+#ifdef SCHED_STATS
+/* ========================================================================== */
+/* Scheduler instrumentation, compiled in only with SCHED_STATS.             */
+/* Printed by thread_print_stats() along with the per-thread counters kept   */
+/* in struct thread.                                                         */
+/* ========================================================================== */
+static long long voluntary_switches;    /* Switches on block, yield or exit. */
+static long long involuntary_switches;  /* Switches forced by preemption. */
+static long long demotions[MLFQ_NUM_QUEUES]; /* Demotions out of each level. */
+static long long boosts;                /* Boosts applied to a run queue. */
+static long long boosted_threads;       /* Threads that applied a boost. */
+static long long yield_fast_paths;      /* Yields that kept the CPU. */
+static int queue_high_water[SCHED_NUM_LEVELS]; /* Deepest each queue got. */
+
+/* Ticks from entering a ready queue to running, per MLFQ priority. */
+static struct histogram dispatch_latency[MLFQ_NUM_QUEUES];
+
+/* True from a preemption request until the next schedule(), so
+   that involuntary switches can be told from voluntary ones. */
+static bool preempt_pending;
+/* ========================================================================== */
+#endif
+
+#ifdef SCHED_TRACE
+/* ========================================================================== */
+/* Scheduler event trace: a fixed ring of the last SCHED_TRACE_SIZE events.  */
+/* Recording is a store into the next slot with interrupts already off, so   */
+/* it never allocates and is safe from the timer interrupt.                  */
+/* ========================================================================== */
+#define SCHED_TRACE_SIZE 4096   /* Events kept; must be a power of 2. */
+static struct sched_event sched_trace_buf[SCHED_TRACE_SIZE];
+static uint32_t sched_trace_next;   /* Events recorded since boot. */
+/* ========================================================================== */
+#endif
+
+#ifdef INTR_PROFILE
+/* ========================================================================== */
+/* Interrupts-off profiler state (see threads/intr-profile.h).  Only one     */
+/* window can be open at a time, since a nested disable is not a window.     */
+/* ========================================================================== */
+#define INTR_PROFILE_REPORT 10  /* Sites thread_print_stats() reports. */
+static struct intr_profile_site *intr_profile_sites; /* Every site seen. */
+static struct intr_profile_site *intr_profile_open;  /* Open window's site. */
+static uint64_t intr_profile_start;                  /* TSC when it opened. */
+/* ========================================================================== */
+#endif
 
 /* Scheduling. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
-static unsigned thread_ticks;   /* # of timer ticks since last yield. */
+static int thread_ticks;        /* # of timer ticks since last yield. */
 
 /* ========================================================================== */
 /* ADDED FOR LAB 4: Counter for priority boosting                             */
@@ -68,6 +243,75 @@ static unsigned thread_ticks;   /* # of timer ticks since last yield. */
 /* When this reaches 50, we boost everyone to prevent starvation.            */
 /* ========================================================================== */
 static int64_t ticks_since_boost = 0;
+
+/* Ticks between boosts, or 0 for no periodic boost.  Set with
+   the -mlfqs-boost kernel command-line option. */
+int mlfq_boost_interval = MLFQ_BOOST_INTERVAL;
+
+/* The dispatch table, indexed by level.  See struct mlfq_dispatch
+   in mlfq-policy.h. */
+#if MLFQ_NUM_QUEUES != 20
+#error "mlfq_dispatch_table's default needs one entry per MLFQ queue"
+#endif
+struct mlfq_dispatch mlfq_dispatch_table[MLFQ_NUM_QUEUES] =
+  {
+    MLFQ_DEFAULT_DISPATCH (0), MLFQ_DEFAULT_DISPATCH (1),
+    MLFQ_DEFAULT_DISPATCH (2), MLFQ_DEFAULT_DISPATCH (3),
+    MLFQ_DEFAULT_DISPATCH (4), MLFQ_DEFAULT_DISPATCH (5),
+    MLFQ_DEFAULT_DISPATCH (6), MLFQ_DEFAULT_DISPATCH (7),
+    MLFQ_DEFAULT_DISPATCH (8), MLFQ_DEFAULT_DISPATCH (9),
+    MLFQ_DEFAULT_DISPATCH (10), MLFQ_DEFAULT_DISPATCH (11),
+    MLFQ_DEFAULT_DISPATCH (12), MLFQ_DEFAULT_DISPATCH (13),
+    MLFQ_DEFAULT_DISPATCH (14), MLFQ_DEFAULT_DISPATCH (15),
+    MLFQ_DEFAULT_DISPATCH (16), MLFQ_DEFAULT_DISPATCH (17),
+    MLFQ_DEFAULT_DISPATCH (18), MLFQ_DEFAULT_DISPATCH (19),
+  };
+
+/* True if some level has a nonzero maxwait. */
+static bool mlfq_starvation_checks;
+
+/* If true, set by the -mlfqs-adaptive kernel command-line option,
+   there is no periodic boost.  Instead a whole level is boosted
+   once the thread at the head of its queue has waited longer
+   than mlfq_starvation_threshold(), which grows with the load
+   average.  A boost interval of 0 still means never to boost. */
+bool mlfq_adaptive_boost;
+
+/* Percentage of each second that real-time threads may use while
+   MLFQ threads are ready; 100 means no limit.  Set with the
+   -rt-share kernel command-line option. */
+int rt_share = 95;
+
+/* If true, set by the -mlfqs-sleep-credit kernel command-line
+   option, a thread waking from timer_sleep() moves up in
+   proportion to how long it slept compared with how long it ran
+   (see thread_mlfq_wake_level()). */
+bool mlfq_sleep_credit;
+
+/* System load average: an exponentially weighted moving average
+   of the number of threads running or ready, updated once a
+   second. */
+static fixed_point load_avg;
+
+/* recent_cpu decays lazily.  Each second that ends records its
+   decay factor here, at its number modulo RECENT_CPU_HISTORY, and a
+   thread applies the factors for the seconds it has missed when
+   it is dispatched or its recent_cpu is read (see
+   recent_cpu_update()), so the per-second cost does not grow with
+   the number of threads.  Only the running thread is updated
+   every second. */
+#define RECENT_CPU_HISTORY 64           /* Must be a power of 2. */
+static fixed_point recent_cpu_decay[RECENT_CPU_HISTORY];
+
+/* Number of seconds that have ended, the last of which has its
+   decay factor in recent_cpu_decay[]. */
+static int64_t decay_seconds;
+
+/* Number of boosts so far.  thread_tick() advances it and the
+   run queue is spliced when run_deferred_work() sees it change; a
+   thread whose boost_epoch differs from it has not applied it
+   yet. */
+static unsigned mlfq_boost_epoch;
 /* ========================================================================== */
 
 /* If false (default), use round-robin scheduler.
@@ -81,25 +325,67 @@ static void idle (void *aux UNUSED);
 static struct thread *running_thread (void);
 static struct thread *next_thread_to_run (void);
 static void init_thread (struct thread *, const char *name, int priority);
+static void init_thread_fields (struct thread *, const char *name,
+                                int priority);
+static void init_thread_frames (struct thread *, thread_func *, void *aux);
 static bool is_thread (struct thread *) UNUSED;
 static void *alloc_frame (struct thread *, size_t size);
 static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
+static tid_t allocate_tids (int n);
+static void tid_index_insert (struct thread *);
 
 /* ========================================================================== */
 /* ADDED FOR LAB 4: Helper function for priority boosting                     */
 /* Moves all threads back to highest priority queue (prevents starvation).   */
 /* ========================================================================== */
-static void mlfq_boost_all (void);
+static void mlfq_boost_all (struct runqueue *);
 /* ========================================================================== */
 
+static void mlfq_apply_boost (struct thread *);
+static void mlfq_enqueue (struct runqueue *, struct thread *);
+static void mlfq_remove (struct runqueue *, struct thread *);
+static int mlfq_level (const struct thread *);
+static void mlfq_set_donation (struct thread *, int level);
+static int mlfq_max_waiter (struct lock *);
+static void mlfq_promote_starved (struct runqueue *);
+static void mlfq_boost_starved (struct runqueue *);
+static void mlfq_boost_level (struct runqueue *, int group, int level);
+static int64_t mlfq_starvation_threshold (void);
+static void load_avg_update (int ready);
+static void recent_cpu_update (struct thread *);
+static bool parse_int (const char **, int *);
+static struct thread *mlfq_dequeue_highest (struct runqueue *);
+static struct list *mlfq_queue_for (struct runqueue *, int group, int level);
+static void mlfq_queue_emptied (struct runqueue *, int group, int level);
+static int mlfq_pick_group (const struct runqueue *);
+static uint32_t mlfq_dispatch_mask (const struct runqueue *);
+static uint32_t mlfq_preempt_mask (const struct runqueue *);
+static bool mlfq_yield_keeps_cpu (const struct runqueue *,
+                                  const struct thread *);
+static tid_t create_thread (const char *name, int priority,
+                            enum sched_policy, int rt_priority,
+                            thread_func *, void *aux);
+static void ready_new_thread (struct thread *);
+static struct runqueue *this_rq (void);
+static void request_preempt (void);
+static void set_status (struct thread *, enum thread_status);
+static int ready_thread_cnt (void);
+static bool run_deferred_work (void);
+static struct thread *page_cache_get (void);
+static void page_cache_put (struct thread *);
+static void page_cache_scrub (void);
+#ifdef SCHED_STATS
+static void print_thread_sched_stats (struct thread *, void *aux);
+#endif
+
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
    general and it is possible in this case only because loader.S
    was careful to put the bottom of the stack at a page boundary.
 
-   Also initializes the run queue and the tid lock.
+   Also initializes the run queues and the tid index.
 
    After calling this function, be sure to initialize the page
    allocator before trying to create any threads with
@@ -111,34 +397,58 @@ void
 thread_init (void) 
 {
   /* ======================================================================== */
-  /* ADDED FOR LAB 4: Loop variable to initialize all 20 MLFQ queues         */
+  /* ADDED FOR LAB 4: Loop variables to initialize all 20 MLFQ queues        */
   /* ======================================================================== */
-  int i;
+  struct runqueue *rq = &runqueue;
+  int g, i;
   /* ======================================================================== */
   
   ASSERT (intr_get_level () == INTR_OFF);
 
-  lock_init (&tid_lock);
-  list_init (&ready_list);
   list_init (&all_list);
+  for (i = 0; i < THREAD_STATE_CNT; i++)
+    list_init (&state_lists[i]);
+  for (i = 0; i < TID_BUCKETS; i++)
+    list_init (&tid_buckets[i]);
+  list_init (&clean_pages);
+  list_init (&dirty_pages);
 
   /* ======================================================================== */
   /* ADDED FOR LAB 4: Initialize all 20 MLFQ priority queues                 */
   /* Each queue starts empty and will hold threads at that priority level.   */
   /* ======================================================================== */
-  for (i = 0; i < MLFQ_NUM_QUEUES; i++)
-    list_init (&mlfq_queues[i]);
+  list_init (&rq->ready_list);
+  for (g = 0; g < SCHED_GROUP_MAX; g++)
+    {
+      for (i = 0; i < MLFQ_NUM_QUEUES; i++)
+        list_init (&rq->groups[g].mlfq_queues[i]);
+      rq->groups[g].ready_mask = 0;
+    }
+  for (i = RT_PRIORITY_MIN; i <= RT_PRIORITY_MAX; i++)
+    list_init (&rq->rt_queues[i]);
+  rq->mlfq_ready_mask = 0;
+  rq->boost_epoch = 0;
+  rq->group_pass = 0;
+  rq->rt_ticks = 0;
+  rq->rt_throttled = false;
+  rq->rt_second = 0;
+  rq->idle_thread = NULL;
+#ifdef SCHED_STATS
+  for (i = 0; i < SCHED_NUM_LEVELS; i++)
+    rq->mlfq_queue_len[i] = 0;
+#endif
   /* ======================================================================== */
 
+  thread_group_create ("default", SCHED_GROUP_WEIGHT_DEFAULT);
+
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread ();
   init_thread (initial_thread, "main", PRI_DEFAULT);
-  initial_thread->status = THREAD_RUNNING;
-  initial_thread->tid = allocate_tid ();
+  set_status (initial_thread, THREAD_RUNNING);
 }
 
 /* Starts preemptive thread scheduling by enabling interrupts.
-   Also creates the idle thread. */
+   Also creates the boot CPU's idle thread. */
 void
 thread_start (void) 
 {
@@ -150,7 +460,7 @@ thread_start (void)
   /* Start preemptive thread scheduling. */
   intr_enable ();
 
-  /* Wait for the idle thread to initialize idle_thread. */
+  /* Wait for the idle thread to initialize this_rq ()->idle_thread. */
   sema_down (&idle_started);
 }
 
@@ -160,9 +470,10 @@ void
 thread_tick (void) 
 {
   struct thread *t = thread_current ();
+  struct runqueue *rq = this_rq ();
 
   /* Update statistics. */
-  if (t == idle_thread)
+  if (t == rq->idle_thread)
     idle_ticks++;
 #ifdef USERPROG
   else if (t->pagedir != NULL)
@@ -171,54 +482,259 @@ thread_tick (void)
   else
     kernel_ticks++;
 
+  /* The running thread is charged the tick, and once a second that
+     ends, the number of running and ready threads is folded into
+     the load average and the running thread's recent_cpu decays.
+     Other threads catch up on the decay when they next run. */
+  if (t != rq->idle_thread)
+    t->recent_cpu = fp_add_int (t->recent_cpu, 1);
+  if (timer_ticks () % TIMER_FREQ == 0)
+    {
+      load_avg_update (ready_thread_cnt () + (t != rq->idle_thread));
+      if (t != rq->idle_thread)
+        recent_cpu_update (t);
+    }
+
+  /* Each second, the real-time class gets a fresh share.  A
+     tickless idle may have skipped the tick that starts the
+     second, so look for a new second rather than its first tick. */
+  if (timer_ticks () / TIMER_FREQ != rq->rt_second)
+    {
+      rq->rt_second = timer_ticks () / TIMER_FREQ;
+      rq->rt_ticks = 0;
+      rq->rt_throttled = false;
+    }
+
   /* ======================================================================== */
   /* ADDED FOR LAB 4: MLFQ scheduling logic                                  */
   /* This runs every tick for threads using MLFQ scheduler.                  */
   /* ======================================================================== */
-  if (thread_mlfqs && t != idle_thread)
+  if (thread_mlfqs && t != rq->idle_thread)
     {
-      /* Count how many ticks this thread has used at current priority */
-      t->ticks_at_priority++;
-      
-      /* Calculate quantum: higher priority = shorter quantum */
-      /* Priority 19 gets 1 tick, priority 18 gets 2 ticks, etc. */
-      int quantum = (MLFQ_PRIORITY_MAX - t->mlfq_priority) + 1;
+      bool preempt = false;
+      bool donated = t->mlfq_donated > t->mlfq_priority;
+      bool rt = mlfq_level (t) > MLFQ_PRIORITY_MAX;
+
+      t->ticks_since_sleep++;
+      sched_groups[t->group].ticks++;
+      if (!rt)
+        sched_groups[t->group].pass += sched_groups[t->group].stride;
+#ifdef SCHED_STATS
+      t->run_ticks++;
+      if (!rt)
+        t->priority_ticks[t->mlfq_priority]++;
+#endif
+
+      /* A thread at a real-time level, by its own class or by
+         donation from a real-time waiter, is never demoted.
+         SCHED_FIFO keeps the CPU; SCHED_RR and donated time-sharing
+         threads take turns with their level every RT_TIME_SLICE
+         ticks.  Once the class has used up its share of the
+         second, MLFQ threads that are ready get the rest. */
+      if (rt)
+        {
+          if (t->sched_policy != SCHED_FIFO && ++thread_ticks >= RT_TIME_SLICE)
+            {
+              thread_ticks = 0;
+              preempt = true;
+            }
+          if (rt_share < 100
+              && ++rq->rt_ticks >= rt_share * TIMER_FREQ / 100)
+            rq->rt_throttled = true;
+          if (rq->rt_throttled
+              && (rq->mlfq_ready_mask & MLFQ_LEVELS_MASK) != 0)
+            preempt = true;
+        }
       
-      /* If thread used up its quantum, move it down one priority */
-      if (t->ticks_at_priority >= quantum && t->mlfq_priority > MLFQ_PRIORITY_MIN)
+      /* Charge the tick against the quantum from the dispatch
+         table.  By default higher priority = shorter quantum:
+         priority 19 gets 1 tick, priority 18 gets 2 ticks, etc.
+         If thread used up its quantum, move it to the table's
+         tqexp level, by default one priority down.  At the lowest
+         priority it just starts a new quantum, so that threads
+         there still run round robin.
+
+         Ticks run at a donated level are not charged: the thread
+         runs on a waiter's behalf and must not be demoted for it.
+         It just takes turns with that level's threads. */
+      else if (donated)
+        {
+          if (++thread_ticks >= mlfq_dispatch_table[t->mlfq_donated].quantum)
+            {
+              thread_ticks = 0;
+              preempt = true;
+            }
+        }
+      else
         {
-          t->mlfq_priority--;           /* Move down one queue */
-          t->ticks_at_priority = 0;     /* Reset tick counter */
+          int old_priority = t->mlfq_priority;
+
+          if (mlfq_policy_charge (mlfq_dispatch_table, &t->mlfq_priority,
+                                  &t->ticks_at_priority))
+            {
+              if (t->mlfq_priority != old_priority)
+                {
+#ifdef SCHED_STATS
+                  if (t->mlfq_priority < old_priority)
+                    demotions[old_priority]++;
+#endif
+                  THREAD_TRACE (SCHED_EV_DEMOTE, t, old_priority,
+                                t->mlfq_priority);
+                }
+              preempt = true;
+            }
         }
 
-      /* Check if it's time to boost all threads (every 50 ticks) */
-      ticks_since_boost++;
-      if (ticks_since_boost >= MLFQ_BOOST_INTERVAL)
+      /* Check if it's time to boost all threads (every 50 ticks
+         by default, never if the interval is 0). */
+      if (!mlfq_adaptive_boost && mlfq_boost_interval > 0
+          && ++ticks_since_boost >= mlfq_boost_interval)
         {
-          mlfq_boost_all ();            /* Boost everyone to top */
+          mlfq_boost_epoch++;           /* Boost everyone to top */
           ticks_since_boost = 0;        /* Reset boost counter */
         }
 
-      /* Force a context switch to let highest priority thread run */
-      intr_yield_on_return ();
+      /* The run queue applies a new boost once the interrupt
+         yields (see run_deferred_work()).  A boost does
+         not move real-time threads, so it is no reason to preempt
+         one. */
+      if (rq->boost_epoch != mlfq_boost_epoch)
+        {
+          if (!rt)
+            preempt = true;
+          else
+            intr_yield_on_return ();
+        }
+
+      /* Move threads that have waited too long up a level, or with
+         adaptive boosting, boost starved levels to the top. */
+      if (mlfq_starvation_checks)
+        mlfq_promote_starved (rq);
+      if (mlfq_adaptive_boost && mlfq_boost_interval > 0)
+        mlfq_boost_starved (rq);
+
+      /* Switch only if the quantum ran out, a boost happened, or a
+         thread at a strictly higher priority is waiting. */
+#ifdef MLFQ_PREEMPT_EVERY_TICK
+      preempt = true;
+#endif
+      if (preempt || thread_mlfq_higher_ready (mlfq_level (t)))
+        request_preempt ();
     }
   else
     {
       /* ORIGINAL CODE: Non-MLFQ preemption (still works for Lab 3) */
       /* Enforce preemption. */
       if (++thread_ticks >= TIME_SLICE)
-        intr_yield_on_return ();
+        request_preempt ();
     }
   /* ======================================================================== */
 }
 
+/* Credits N timer ticks, which the timer skipped while the CPU
+   was halted in the idle thread, to the idle statistics. */
+void
+thread_skip_idle_ticks (int64_t n)
+{
+  int64_t now = timer_ticks ();
+  int64_t seconds;
+
+  idle_ticks += n;
+
+  /* Catch up on the load average updates that the skipped ticks
+     would have made, with only the idle thread running. */
+  for (seconds = now / TIMER_FREQ - (now - n) / TIMER_FREQ; seconds > 0;
+       seconds--)
+    load_avg_update (ready_thread_cnt ());
+}
+
 /* Prints thread statistics. */
 void
 thread_print_stats (void) 
 {
   printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
           idle_ticks, kernel_ticks, user_ticks);
+  printf ("Thread: %lld context switches, %lld preemptions\n",
+          context_switches, preemptions);
+  printf ("Thread: %d running, %d ready, %d blocked\n",
+          thread_count_state (THREAD_RUNNING), thread_count_state (THREAD_READY),
+          thread_count_state (THREAD_BLOCKED));
+  printf ("Thread: page cache %lld hits, %lld dirty hits, %lld misses\n",
+          page_cache_hits, page_cache_dirty_hits, page_cache_misses);
+  if (thread_mlfqs)
+    {
+      int g;
+
+      for (g = 0; g < sched_group_cnt; g++)
+        printf ("Thread: group %d (%s): weight %d, %lld ticks\n",
+                g, sched_groups[g].name, sched_groups[g].weight,
+                sched_groups[g].ticks);
+    }
+#ifdef SCHED_STATS
+  {
+    enum intr_level old_level;
+    int i;
+
+    printf ("Scheduler: %lld voluntary switches, %lld involuntary switches\n",
+            voluntary_switches, involuntary_switches);
+    printf ("Scheduler: %lld boosts, %lld threads boosted\n",
+            boosts, boosted_threads);
+    printf ("Scheduler: %lld yields without a switch\n", yield_fast_paths);
+    for (i = MLFQ_PRIORITY_MAX; i >= MLFQ_PRIORITY_MIN; i--)
+      printf ("Scheduler: queue %2d: %lld demotions, high water %d\n",
+              i, demotions[i], queue_high_water[i]);
+    for (i = MLFQ_PRIORITY_MAX; i >= MLFQ_PRIORITY_MIN; i--)
+      if (histogram_total (&dispatch_latency[i]) != 0)
+        {
+          char prefix[48];
+          snprintf (prefix, sizeof prefix,
+                    "Scheduler: queue %2d dispatch latency (ticks):", i);
+          histogram_print (prefix, &dispatch_latency[i]);
+        }
+
+    /* Dying threads are left out, as they are off all_list. */
+    old_level = intr_disable ();
+    thread_foreach_state (THREAD_RUNNING, print_thread_sched_stats, NULL);
+    thread_foreach_state (THREAD_READY, print_thread_sched_stats, NULL);
+    thread_foreach_state (THREAD_BLOCKED, print_thread_sched_stats, NULL);
+    intr_set_level (old_level);
+  }
+#endif
+#ifdef SCHED_TRACE
+  thread_trace_dump ();
+#endif
+#ifdef INTR_PROFILE
+  intr_profile_print ();
+#endif
+}
+
+#ifdef SCHED_STATS
+/* Prints T's scheduler counters: ticks running, ticks waiting in
+   a ready queue, and the ticks it ran at each MLFQ priority it
+   has used. */
+static void
+print_thread_sched_stats (struct thread *t, void *aux UNUSED)
+{
+  int i;
+
+  printf ("Scheduler: thread %d (%s): %lld ticks running, %lld ticks ready,",
+          t->tid, t->name, t->run_ticks, t->ready_ticks);
+  for (i = MLFQ_PRIORITY_MAX; i >= MLFQ_PRIORITY_MIN; i--)
+    if (t->priority_ticks[i] != 0)
+      printf (" q%d=%d", i, t->priority_ticks[i]);
+  printf ("\n");
+}
+
+/* Returns the number of ticks the running thread has run at MLFQ
+   priority PRIORITY. */
+int
+thread_get_priority_ticks (int priority)
+{
+  ASSERT (priority >= MLFQ_PRIORITY_MIN && priority <= MLFQ_PRIORITY_MAX);
+
+  return thread_current ()->priority_ticks[priority];
 }
+#endif
 
 /* Creates a new kernel thread named NAME with the given initial
    PRIORITY, which executes FUNCTION passing AUX as the argument,
@@ -238,41 +754,143 @@ thread_print_stats (void)
 tid_t
 thread_create (const char *name, int priority,
                thread_func *function, void *aux) 
+{
+  return create_thread (name, priority, SCHED_OTHER, 0, function, aux);
+}
+
+/* Creates a new kernel thread like thread_create(), but in
+   scheduling class POLICY at real-time priority RT_PRIORITY,
+   which is ignored for SCHED_OTHER.  Under the MLFQ scheduler a
+   new real-time thread preempts the caller at once if it
+   outranks it.  Without the MLFQ scheduler the class is recorded
+   but has no effect. */
+tid_t
+thread_create_rt (const char *name, enum sched_policy policy,
+                  int rt_priority, thread_func *function, void *aux)
+{
+  return create_thread (name, PRI_DEFAULT, policy, rt_priority,
+                        function, aux);
+}
+
+/* Does the work of thread_create() and thread_create_rt(). */
+static tid_t
+create_thread (const char *name, int priority, enum sched_policy policy,
+               int rt_priority, thread_func *function, void *aux)
 {
   struct thread *t;
-  struct kernel_thread_frame *kf;
-  struct switch_entry_frame *ef;
-  struct switch_threads_frame *sf;
+  enum intr_level old_level;
   tid_t tid;
 
   ASSERT (function != NULL);
+  ASSERT (policy == SCHED_OTHER
+          || (rt_priority >= RT_PRIORITY_MIN
+              && rt_priority <= RT_PRIORITY_MAX));
 
   /* Allocate thread. */
-  t = palloc_get_page (PAL_ZERO);
+  t = page_cache_get ();
   if (t == NULL)
     return TID_ERROR;
 
   /* Initialize thread. */
   init_thread (t, name, priority);
-  tid = t->tid = allocate_tid ();
+  tid = t->tid;
+  t->sched_policy = policy;
+  t->rt_priority = policy != SCHED_OTHER ? rt_priority : 0;
+  init_thread_frames (t, function, aux);
 
-  /* Stack frame for kernel_thread(). */
-  kf = alloc_frame (t, sizeof *kf);
-  kf->eip = NULL;
-  kf->function = function;
-  kf->aux = aux;
+  /* Add to run queue.  Interrupts stay off until T has been
+     looked at, so that it cannot run and exit first. */
+  old_level = intr_disable ();
+  ready_new_thread (t);
+  intr_set_level (old_level);
 
-  /* Stack frame for switch_entry(). */
-  ef = alloc_frame (t, sizeof *ef);
-  ef->eip = (void (*) (void)) kernel_thread;
+  return tid;
+}
 
-  /* Stack frame for switch_threads(). */
-  sf = alloc_frame (t, sizeof *sf);
-  sf->eip = switch_entry;
-  sf->ebp = 0;
+/* Makes new thread T, which is still on the blocked list,
+   ready to run, for thread_create() and thread_create_batch()
+   alike.  T goes through thread_unblock(), which applies any
+   boost still pending, and a real-time T preempts the caller if
+   it outranks it; a new SCHED_OTHER thread does not.  Interrupts
+   must be off. */
+static void
+ready_new_thread (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
 
-  /* Add to run queue. */
   thread_unblock (t);
+  if (t->sched_policy != SCHED_OTHER)
+    thread_preempt_for (t);
+}
+
+/* Creates N kernel threads at once, each with the given initial
+   PRIORITY.  Thread I is named by formatting I with NAME_FMT,
+   which must take a single int conversion, and runs FUNCTION
+   passing AUX[I] as the argument, or a null pointer if AUX is
+   null.  The threads get consecutive tids, so thread I's tid is
+   the returned tid plus I.  Returns TID_ERROR, having created no
+   threads, if memory runs out.
+
+   Unlike N calls to thread_create(), this claims all N tids with
+   one atomic add to the tid counter (see allocate_tids()) and
+   makes every thread ready in a single interrupts-off section,
+   each one exactly as thread_create() would (see
+   ready_new_thread()).  The same ordering caveats apply. */
+tid_t
+thread_create_batch (int n, const char *name_fmt, int priority,
+                     thread_func *function, void **aux)
+{
+  struct list batch;
+  struct list_elem *e;
+  enum intr_level old_level;
+  tid_t tid;
+  int i;
+
+  ASSERT (!intr_context ());
+  ASSERT (n > 0);
+  ASSERT (name_fmt != NULL);
+  ASSERT (function != NULL);
+
+  /* Allocate and initialize every thread before touching the
+     shared lists, chaining them on BATCH through allelem. */
+  list_init (&batch);
+  for (i = 0; i < n; i++)
+    {
+      struct thread *t = page_cache_get ();
+      char name[sizeof t->name];
+
+      if (t == NULL)
+        {
+          old_level = intr_disable ();
+          while (!list_empty (&batch))
+            page_cache_put (list_entry (list_pop_front (&batch),
+                                        struct thread, allelem));
+          intr_set_level (old_level);
+          return TID_ERROR;
+        }
+      snprintf (name, sizeof name, name_fmt, i);
+      init_thread_fields (t, name, priority);
+      init_thread_frames (t, function, aux != NULL ? aux[i] : NULL);
+      list_push_back (&batch, &t->allelem);
+    }
+
+  tid = allocate_tids (n);
+  i = 0;
+  for (e = list_begin (&batch); e != list_end (&batch); e = list_next (e))
+    list_entry (e, struct thread, allelem)->tid = tid + i++;
+
+  old_level = intr_disable ();
+  for (e = list_begin (&batch); e != list_end (&batch); e = list_next (e))
+    {
+      struct thread *t = list_entry (e, struct thread, allelem);
+
+      list_push_back (&state_lists[THREAD_BLOCKED], &t->stateelem);
+      state_counts[THREAD_BLOCKED]++;
+      tid_index_insert (t);
+      ready_new_thread (t);
+    }
+  list_splice (list_end (&all_list), list_begin (&batch), list_end (&batch));
+  intr_set_level (old_level);
 
   return tid;
 }
@@ -289,7 +907,7 @@ thread_block (void)
   ASSERT (!intr_context ());
   ASSERT (intr_get_level () == INTR_OFF);
 
-  thread_current ()->status = THREAD_BLOCKED;
+  set_status (thread_current (), THREAD_BLOCKED);
   schedule ();
 }
 
@@ -308,7 +926,7 @@ thread_unblock (struct thread *t)
 
   ASSERT (is_thread (t));
 
-  old_level = intr_disable ();
+  old_level = INTR_PROFILE_DISABLE ();
   ASSERT (t->status == THREAD_BLOCKED);
   
   /* ======================================================================== */
@@ -317,13 +935,30 @@ thread_unblock (struct thread *t)
   /* If MLFQ is off, use the original ready_list (for Lab 3 compatibility).  */
   /* ======================================================================== */
   if (thread_mlfqs)
-    list_push_back (&mlfq_queues[t->mlfq_priority], &t->mlfq_elem);
+    {
+      mlfq_apply_boost (t);
+      mlfq_enqueue (this_rq (), t);
+    }
   else
-    list_push_back (&ready_list, &t->elem);
+    list_push_back (&this_rq ()->ready_list, &t->elem);
   /* ======================================================================== */
     
-  t->status = THREAD_READY;
-  intr_set_level (old_level);
+  set_status (t, THREAD_READY);
+  THREAD_TRACE (SCHED_EV_UNBLOCK, t, t->mlfq_priority, t->mlfq_priority);
+
+  /* A thread woken from an interrupt handler (e.g. a sub-tick
+     sleeper) preempts the running thread at once if it outranks
+     it, since thread_tick() no longer switches on every tick.
+     Timer wakeups are unblocked after the handler instead, and
+     thread_yield() decides once for all of them. */
+  if (thread_mlfqs && intr_context ())
+    {
+      struct thread *cur = running_thread ();
+      if (cur == this_rq ()->idle_thread
+          || thread_mlfq_higher_ready (mlfq_level (cur)))
+        request_preempt ();
+    }
+  INTR_PROFILE_SET_LEVEL (old_level);
 }
 
 /* Returns the name of the running thread. */
@@ -375,7 +1010,8 @@ thread_exit (void)
      when it calls thread_schedule_tail(). */
   intr_disable ();
   list_remove (&thread_current()->allelem);
-  thread_current ()->status = THREAD_DYING;
+  list_remove (&thread_current()->tidelem);
+  set_status (thread_current (), THREAD_DYING);
   schedule ();
   NOT_REACHED ();
 }
@@ -387,25 +1023,58 @@ thread_yield (void)
 {
   struct thread *cur = thread_current ();
   enum intr_level old_level;
+  bool preempt;
   
   ASSERT (!intr_context ());
 
-  old_level = intr_disable ();
-  if (cur != idle_thread)
+  old_level = INTR_PROFILE_DISABLE ();
+  preempt = preempt_requested;
+  preempt_requested = false;
+
+  /* If the interrupt we are returning from only yielded to hand
+     over deferred work, keep running unless that work made a
+     thread ready that outranks us.  This is the one preemption
+     decision for all the threads it woke. */
+  if (run_deferred_work () && !preempt)
+    {
+      if (cur != this_rq ()->idle_thread
+          && (!thread_mlfqs || !thread_mlfq_higher_ready (mlfq_level (cur))))
+        {
+          INTR_PROFILE_SET_LEVEL (old_level);
+          return;
+        }
+      preemptions++;
+#ifdef SCHED_STATS
+      preempt_pending = true;
+#endif
+    }
+
+  /* If schedule() would just pick us again, keep running. */
+  if (thread_mlfqs && cur != this_rq ()->idle_thread
+      && mlfq_yield_keeps_cpu (this_rq (), cur))
+    {
+#ifdef SCHED_STATS
+      yield_fast_paths++;
+#endif
+      INTR_PROFILE_SET_LEVEL (old_level);
+      return;
+    }
+
+  if (cur != this_rq ()->idle_thread)
     {
       /* ==================================================================== */
       /* ADDED FOR LAB 4: Choose which queue to add thread to                */
       /* If MLFQ is on, add to the priority queue. Otherwise use ready_list. */
       /* ==================================================================== */
       if (thread_mlfqs)
-        list_push_back (&mlfq_queues[cur->mlfq_priority], &cur->mlfq_elem);
+        mlfq_enqueue (this_rq (), cur);
       else
-        list_push_back (&ready_list, &cur->elem);
+        list_push_back (&this_rq ()->ready_list, &cur->elem);
       /* ==================================================================== */
     }
-  cur->status = THREAD_READY;
+  set_status (cur, THREAD_READY);
   schedule ();
-  intr_set_level (old_level);
+  INTR_PROFILE_SET_LEVEL (old_level);
 }
 
 /* Invoke function 'func' on all threads, passing along 'aux'.
@@ -425,6 +1094,48 @@ thread_foreach (thread_action_func *func, void *aux)
     }
 }
 
+/* Invokes FUNC on each thread whose status is STATUS, passing
+   along AUX.  Unlike thread_foreach(), this takes time in
+   proportion to the number of threads in that state.  FUNC must
+   not change any thread's status.  This function must be called
+   with interrupts off. */
+void
+thread_foreach_state (enum thread_status status, thread_action_func *func,
+                      void *aux)
+{
+  struct list *list = &state_lists[status];
+  struct list_elem *e;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (status < THREAD_STATE_CNT);
+
+  for (e = list_begin (list); e != list_end (list); e = list_next (e))
+    func (list_entry (e, struct thread, stateelem), aux);
+}
+
+/* Returns the number of threads whose status is STATUS, counting
+   idle threads. */
+int
+thread_count_state (enum thread_status status)
+{
+  ASSERT (status < THREAD_STATE_CNT);
+
+  return state_counts[status];
+}
+
+/* Returns the number of threads in THREAD_READY, not counting the
+   idle thread, which is marked ready when it yields but never
+   queued.  Together with the running thread this is the load that
+   load_avg tracks. */
+static int
+ready_thread_cnt (void)
+{
+  struct thread *idle = this_rq ()->idle_thread;
+
+  return (state_counts[THREAD_READY]
+          - (idle != NULL && idle->status == THREAD_READY));
+}
+
 /* Sets the current thread's priority to NEW_PRIORITY. */
 void
 thread_set_priority (int new_priority) 
@@ -438,7 +1149,99 @@ thread_set_priority (int new_priority)
   /* ======================================================================== */
 }
 
-/* Returns the current thread's priority. */
+/* Moves the running thread to scheduling class POLICY, at
+   real-time priority RT_PRIORITY unless POLICY is SCHED_OTHER.
+   A thread leaving the real-time class rejoins the MLFQ at the
+   level it left, or at the top if a boost happened meanwhile,
+   and yields if something higher is ready. */
+void
+thread_set_sched (enum sched_policy policy, int rt_priority)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+  int before;
+
+  ASSERT (!intr_context ());
+  ASSERT (policy == SCHED_OTHER
+          || (rt_priority >= RT_PRIORITY_MIN
+              && rt_priority <= RT_PRIORITY_MAX));
+
+  old_level = intr_disable ();
+  before = mlfq_level (cur);
+  cur->sched_policy = policy;
+  cur->rt_priority = policy != SCHED_OTHER ? rt_priority : 0;
+  if (thread_mlfqs)
+    {
+      mlfq_apply_boost (cur);
+      if (mlfq_level (cur) < before)
+        thread_yield ();
+    }
+  intr_set_level (old_level);
+}
+
+/* Creates a scheduling group named NAME whose threads together
+   get CPU in proportion to WEIGHT, between 1 and
+   SCHED_GROUP_WEIGHT_MAX, when other groups are busy too.  It
+   starts level with the groups that have run so far.  Returns
+   the new group's number, or -1 if SCHED_GROUP_MAX groups exist
+   already. */
+int
+thread_group_create (const char *name, int weight)
+{
+  struct sched_group *group;
+  enum intr_level old_level;
+  int g;
+
+  ASSERT (name != NULL);
+  ASSERT (weight >= 1 && weight <= SCHED_GROUP_WEIGHT_MAX);
+
+  old_level = intr_disable ();
+  if (sched_group_cnt >= SCHED_GROUP_MAX)
+    {
+      intr_set_level (old_level);
+      return -1;
+    }
+  g = sched_group_cnt;
+  group = &sched_groups[g];
+  strlcpy (group->name, name, sizeof group->name);
+  group->weight = weight;
+  group->stride = SCHED_STRIDE1 / weight;
+  group->pass = this_rq ()->group_pass;
+  group->ticks = 0;
+  sched_group_cnt++;
+  intr_set_level (old_level);
+
+  return g;
+}
+
+/* Moves the running thread to scheduling group GROUP.  Threads
+   it creates from now on start in GROUP too.  It yields, so that
+   the dispatcher can weigh GROUP against the others. */
+void
+thread_set_group (int group)
+{
+  enum intr_level old_level;
+
+  ASSERT (!intr_context ());
+  ASSERT (group >= 0 && group < sched_group_cnt);
+
+  old_level = intr_disable ();
+  thread_current ()->group = group;
+  if (thread_mlfqs)
+    thread_yield ();
+  intr_set_level (old_level);
+}
+
+/* Returns the running thread's scheduling group. */
+int
+thread_get_group (void)
+{
+  return thread_current ()->group;
+}
+
+/* Returns the current thread's priority.  Under the MLFQ
+   scheduler that is its scheduling level, which is above
+   MLFQ_PRIORITY_MAX for a real-time thread. */
 int
 thread_get_priority (void) 
 {
@@ -446,42 +1249,111 @@ thread_get_priority (void)
   /* ADDED FOR LAB 4: Return MLFQ priority if MLFQ is enabled                */
   /* Otherwise return the regular priority (for Lab 3 compatibility).        */
   /* ======================================================================== */
+  /* A donated MLFQ level counts, as it does for scheduling.         */
+  /* ======================================================================== */
   if (thread_mlfqs)
-    return thread_current ()->mlfq_priority;
+    return mlfq_level (thread_current ());
   /* ======================================================================== */
   
   return thread_current ()->priority;
 }
 
-/* Sets the current thread's nice value to NICE. */
+/* Sets the current thread's nice value to NICE, which is clamped
+   to the range NICE_MIN to NICE_MAX.  It takes effect from the
+   next second that ends. */
 void
-thread_set_nice (int nice UNUSED) 
+thread_set_nice (int nice) 
 {
-  /* Not yet implemented. */
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  if (nice < NICE_MIN)
+    nice = NICE_MIN;
+  else if (nice > NICE_MAX)
+    nice = NICE_MAX;
+
+  old_level = intr_disable ();
+  recent_cpu_update (cur);
+  cur->nice = nice;
+  intr_set_level (old_level);
 }
 
 /* Returns the current thread's nice value. */
 int
 thread_get_nice (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  return thread_current ()->nice;
 }
 
 /* Returns 100 times the system load average. */
 int
 thread_get_load_avg (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable ();
+  int load = fp_round (load_avg * 100);
+  intr_set_level (old_level);
+
+  return load;
 }
 
-/* Returns 100 times the current thread's recent_cpu value. */
-int
+/* Updates the load average for a second in which READY threads
+   were running or ready:
+   load_avg = (59/60) * load_avg + (1/60) * READY. */
+static void
+load_avg_update (int ready)
+{
+  load_avg = mlfq_policy_load_avg (load_avg, ready);
+
+  /* The second that just ended decays recent_cpu by a factor
+     based on the new load average. */
+  decay_seconds++;
+  recent_cpu_decay[decay_seconds & (RECENT_CPU_HISTORY - 1)]
+    = mlfq_policy_recent_cpu_decay (load_avg);
+}
+
+/* Brings T's recent_cpu up to date with the seconds that have
+   ended since it last was.  Seconds that have dropped out of
+   recent_cpu_decay[] are applied at the oldest factor still
+   recorded.  Interrupts must be off. */
+static void
+recent_cpu_update (struct thread *t)
+{
+  int64_t behind = decay_seconds - t->recent_cpu_second;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (behind > RECENT_CPU_HISTORY)
+    {
+      fixed_point oldest = recent_cpu_decay[(decay_seconds + 1)
+                                            & (RECENT_CPU_HISTORY - 1)];
+
+      t->recent_cpu = mlfq_policy_recent_cpu (t->recent_cpu, oldest, t->nice,
+                                              behind - RECENT_CPU_HISTORY);
+      behind = RECENT_CPU_HISTORY;
+    }
+  for (; behind > 0; behind--)
+    {
+      int64_t second = decay_seconds - behind + 1;
+      fixed_point decay = recent_cpu_decay[second & (RECENT_CPU_HISTORY - 1)];
+
+      t->recent_cpu = mlfq_policy_recent_cpu (t->recent_cpu, decay, t->nice, 1);
+    }
+  t->recent_cpu_second = decay_seconds;
+}
+
+/* Returns 100 times the current thread's recent_cpu value. */
+int
 thread_get_recent_cpu (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  struct thread *cur = thread_current ();
+  enum intr_level old_level = intr_disable ();
+  int recent_cpu;
+
+  recent_cpu_update (cur);
+  recent_cpu = fp_round (cur->recent_cpu * 100);
+  intr_set_level (old_level);
+
+  return recent_cpu;
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
@@ -497,15 +1369,32 @@ static void
 idle (void *idle_started_ UNUSED) 
 {
   struct semaphore *idle_started = idle_started_;
-  idle_thread = thread_current ();
+  this_rq ()->idle_thread = thread_current ();
   sema_up (idle_started);
 
   for (;;) 
     {
+      /* Zero the pages of threads that exited while the CPU has
+         nothing better to do. */
+      page_cache_scrub ();
+
       /* Let someone else run. */
       intr_disable ();
+      timer_idle_exit ();
       thread_block ();
 
+      /* Nothing else is ready: stop the periodic tick, if enabled,
+         until the next timer_sleep() deadline. */
+      timer_idle_enter ();
+
+      /* In virtual time, advance the clock instead of waiting
+         for it. */
+      if (timer_virtual_idle ())
+        {
+          intr_enable ();
+          continue;
+        }
+
       /* Re-enable interrupts and wait for the next one.
 
          The `sti' instruction disables interrupts until the
@@ -561,6 +1450,22 @@ init_thread (struct thread *t, const char *name, int priority)
 {
   enum intr_level old_level;
 
+  init_thread_fields (t, name, priority);
+  t->tid = allocate_tid ();
+
+  old_level = intr_disable ();
+  list_push_back (&all_list, &t->allelem);
+  list_push_back (&state_lists[THREAD_BLOCKED], &t->stateelem);
+  state_counts[THREAD_BLOCKED]++;
+  tid_index_insert (t);
+  intr_set_level (old_level);
+}
+
+/* Does the part of init_thread() that touches only T itself,
+   leaving T without a tid and off all_list. */
+static void
+init_thread_fields (struct thread *t, const char *name, int priority)
+{
   ASSERT (t != NULL);
   ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
   ASSERT (name != NULL);
@@ -570,6 +1475,12 @@ init_thread (struct thread *t, const char *name, int priority)
   strlcpy (t->name, name, sizeof t->name);
   t->stack = (uint8_t *) t + PGSIZE;
   t->priority = priority;
+  t->mlfq_donated = MLFQ_NO_DONATION;
+  t->group = running_thread ()->group;
+  t->nice = running_thread ()->nice;
+  t->recent_cpu = running_thread ()->recent_cpu;
+  t->recent_cpu_second = running_thread ()->recent_cpu_second;
+  list_init (&t->held_locks);
   t->magic = THREAD_MAGIC;
 
   /* ======================================================================== */
@@ -580,12 +1491,35 @@ init_thread (struct thread *t, const char *name, int priority)
     {
       t->mlfq_priority = MLFQ_PRIORITY_MAX;    /* Start at top queue */
       t->ticks_at_priority = 0;                /* Haven't used any time yet */
+      t->boost_epoch = mlfq_boost_epoch;       /* Already at the top */
     }
   /* ======================================================================== */
+}
 
-  old_level = intr_disable ();
-  list_push_back (&all_list, &t->allelem);
-  intr_set_level (old_level);
+/* Builds the initial stack frames on blocked thread T's stack, so
+   that the first switch to T runs FUNCTION (AUX) through
+   kernel_thread(). */
+static void
+init_thread_frames (struct thread *t, thread_func *function, void *aux)
+{
+  struct kernel_thread_frame *kf;
+  struct switch_entry_frame *ef;
+  struct switch_threads_frame *sf;
+
+  /* Stack frame for kernel_thread(). */
+  kf = alloc_frame (t, sizeof *kf);
+  kf->eip = NULL;
+  kf->function = function;
+  kf->aux = aux;
+
+  /* Stack frame for switch_entry(). */
+  ef = alloc_frame (t, sizeof *ef);
+  ef->eip = (void (*) (void)) kernel_thread;
+
+  /* Stack frame for switch_threads(). */
+  sf = alloc_frame (t, sizeof *sf);
+  sf->eip = switch_entry;
+  sf->ebp = 0;
 }
 
 /* Allocates a SIZE-byte frame at the top of thread T's stack and
@@ -609,33 +1543,29 @@ alloc_frame (struct thread *t, size_t size)
 static struct thread *
 next_thread_to_run (void) 
 {
+  struct runqueue *rq = this_rq ();
+
   /* ======================================================================== */
   /* ADDED FOR LAB 4: Use MLFQ scheduler if enabled                          */
-  /* Search from highest priority (19) down to lowest (0) for a ready thread.*/
+  /* Pick from the highest non-empty queue, found through mlfq_ready_mask.   */
   /* ======================================================================== */
   if (thread_mlfqs)
     {
-      int i;
-      /* Search each queue from highest to lowest priority */
-      for (i = MLFQ_PRIORITY_MAX; i >= MLFQ_PRIORITY_MIN; i--)
-        {
-          if (!list_empty (&mlfq_queues[i]))
-            {
-              /* Found a thread at this priority - pick first one (round robin) */
-              struct list_elem *e = list_pop_front (&mlfq_queues[i]);
-              return list_entry (e, struct thread, mlfq_elem);
-            }
-        }
+      /* The highest set bit of the ready mask is the highest non-empty
+         queue; take its first thread (round robin). */
+      if (rq->mlfq_ready_mask != 0)
+        return mlfq_dequeue_highest (rq);
+
       /* All queues empty, return idle thread */
-      return idle_thread;
+      return rq->idle_thread;
     }
   /* ======================================================================== */
   
   /* from original pintos file */
-  if (list_empty (&ready_list))
-    return idle_thread;
+  if (list_empty (&rq->ready_list))
+    return rq->idle_thread;
   else
-    return list_entry (list_pop_front (&ready_list), struct thread, elem);
+    return list_entry (list_pop_front (&rq->ready_list), struct thread, elem);
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -662,10 +1592,23 @@ thread_schedule_tail (struct thread *prev)
   ASSERT (intr_get_level () == INTR_OFF);
 
   /* Mark us as running. */
-  cur->status = THREAD_RUNNING;
+  set_status (cur, THREAD_RUNNING);
 
   /* Start new time slice. */
   thread_ticks = 0;
+  if (cur != this_rq ()->idle_thread)
+    recent_cpu_update (cur);
+
+#ifdef SCHED_STATS
+  /* Time from thread_unblock(), a timer wakeup or a yield until now. */
+  if (thread_mlfqs && cur != this_rq ()->idle_thread)
+    histogram_add (&dispatch_latency[cur->mlfq_priority],
+                   timer_ticks () - cur->ready_since);
+#endif
+
+  /* Restart the periodic tick if we are leaving a tickless idle. */
+  if (prev != NULL && prev == this_rq ()->idle_thread)
+    timer_idle_exit ();
 
 #ifdef USERPROG
   /* Activate the new address space. */
@@ -677,10 +1620,15 @@ thread_schedule_tail (struct thread *prev)
      pull out the rug under itself.  (We don't free
      initial_thread because its memory was not obtained via
      palloc().) */
+  if (prev != NULL && prev->status == THREAD_DYING)
+    {
+      list_remove (&prev->stateelem);
+      state_counts[THREAD_DYING]--;
+    }
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread) 
     {
       ASSERT (prev != cur);
-      palloc_free_page (prev);
+      page_cache_put (prev);
     }
 }
 
@@ -702,8 +1650,29 @@ schedule (void)
   ASSERT (cur->status != THREAD_RUNNING);
   ASSERT (is_thread (next));
 
+#ifdef SCHED_STATS
   if (cur != next)
-    prev = switch_threads (cur, next);
+    {
+      if (preempt_pending && cur->status == THREAD_READY)
+        involuntary_switches++;
+      else
+        voluntary_switches++;
+    }
+  preempt_pending = false;
+#endif
+#ifdef INTR_PROFILE
+  /* The switch ends the window of whoever disabled interrupts. */
+  if (intr_profile_open != NULL)
+    intr_profile_end ();
+#endif
+
+  if (cur != next)
+    {
+      context_switches++;
+      THREAD_TRACE (SCHED_EV_SWITCH, next, cur->mlfq_priority,
+                    next->mlfq_priority);
+      prev = switch_threads (cur, next);
+    }
   thread_schedule_tail (prev);
 }
 
@@ -711,59 +1680,1047 @@ schedule (void)
 static tid_t
 allocate_tid (void) 
 {
-  static tid_t next_tid = 1;
-  tid_t tid;
+  return allocate_tids (1);
+}
 
-  lock_acquire (&tid_lock);
-  tid = next_tid++;
-  lock_release (&tid_lock);
+/* Returns the first of N consecutive tids to use for new
+   threads.  The counter is bumped with one atomic exchange-and-
+   add, so this neither sleeps nor needs interrupts off. */
+static tid_t
+allocate_tids (int n)
+{
+  static tid_t next_tid = 1;
+  tid_t tid = n;
 
+  asm volatile ("lock xaddl %0, %1"
+                : "+r" (tid), "+m" (next_tid) : : "memory");
   return tid;
 }
 
+/* Adds T, which must have its tid, to the tid index.  Interrupts
+   must be off. */
+static void
+tid_index_insert (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  list_push_back (&tid_buckets[t->tid & (TID_BUCKETS - 1)], &t->tidelem);
+}
+
+/* Returns the live thread whose tid is TID, or a null pointer if
+   there is none.  A thread that has called thread_exit() is not
+   found.  Unless interrupts are off, the thread may exit as soon
+   as this returns, so callers that dereference the result should
+   disable interrupts around the lookup and its use. */
+struct thread *
+thread_find (tid_t tid)
+{
+  struct thread *found = NULL;
+  struct list *bucket = &tid_buckets[tid & (TID_BUCKETS - 1)];
+  struct list_elem *e;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  for (e = list_begin (bucket); e != list_end (bucket); e = list_next (e))
+    {
+      struct thread *t = list_entry (e, struct thread, tidelem);
+      if (t->tid == tid)
+        {
+          found = t;
+          break;
+        }
+    }
+  intr_set_level (old_level);
+
+  return found;
+}
+
 /* Offset of `stack' member within `struct thread'.
    Used by switch.S, which can't figure it out on its own. */
 uint32_t thread_stack_ofs = offsetof (struct thread, stack);
 
+#ifndef THREAD_SPREAD_LAYOUT
+/* Fails to compile if the scheduler's hot members of struct
+   thread no longer fit in its first cache line. */
+typedef char thread_hot_members_fit
+  [THREAD_HOT_END <= THREAD_HOT_BYTES ? 1 : -1];
+#endif
+
 /* ============================================================================ */
 /* for lab4: Helper function to boost all threads to highest priority   */
 /* This prevents starvation called every 50 ticks to give all threads a      */
 /* fresh start at the top priority queue.                                      */
 /* ============================================================================ */
+/* The boost is lazy: thread_tick() advances mlfq_boost_epoch, and the run    */
+/* queue then splices every lower queue onto its top queue, one step per      */
+/* queue.  Each thread resets its own MLFQ state in                           */
+/* mlfq_apply_boost() the next time it is dispatched, unblocked or woken, so  */
+/* the interrupt does O(MLFQ_NUM_QUEUES) work, not O(threads).                */
+/* ============================================================================ */
 static void
-mlfq_boost_all (void)
+mlfq_boost_all (struct runqueue *rq)
 {
-  struct list_elem *e;
-  struct thread *t;
-  int i;
+  uint32_t top_mask = 0;
+  int g, i;
   ASSERT (intr_get_level () == INTR_OFF);
-  /* Moving all threads from lower priority queues to the highest queue */
+
+  rq->boost_epoch = mlfq_boost_epoch;
+#ifdef SCHED_STATS
+  boosts++;
+#endif
+
+  /* Moving all threads from lower priority queues to the highest queue,
+     lowest queue first, in the order they were waiting, in each group
+     that has any */
+  for (g = 0; g < sched_group_cnt; g++)
+    {
+      struct group_queues *gq = &rq->groups[g];
+      struct list *top = &gq->mlfq_queues[MLFQ_PRIORITY_MAX];
+
+      if (gq->ready_mask == 0)
+        continue;
+      for (i = MLFQ_PRIORITY_MIN; i < MLFQ_PRIORITY_MAX; i++)
+        list_splice (list_end (top), list_begin (&gq->mlfq_queues[i]),
+                     list_end (&gq->mlfq_queues[i]));
+      gq->ready_mask = 1u << MLFQ_PRIORITY_MAX;
+      top_mask = gq->ready_mask;
+    }
+#ifdef SCHED_STATS
   for (i = MLFQ_PRIORITY_MIN; i < MLFQ_PRIORITY_MAX; i++)
     {
-      while (!list_empty (&mlfq_queues[i]))
+      rq->mlfq_queue_len[MLFQ_PRIORITY_MAX] += rq->mlfq_queue_len[i];
+      rq->mlfq_queue_len[i] = 0;
+      if (rq->mlfq_queue_len[MLFQ_PRIORITY_MAX]
+          > queue_high_water[MLFQ_PRIORITY_MAX])
+        queue_high_water[MLFQ_PRIORITY_MAX]
+          = rq->mlfq_queue_len[MLFQ_PRIORITY_MAX];
+    }
+#endif
+
+  /* Only the top MLFQ queues can be non-empty now.  The real-time
+     queues are left alone. */
+  rq->mlfq_ready_mask = (rq->mlfq_ready_mask & ~MLFQ_LEVELS_MASK) | top_mask;
+
+  /* The running thread is boosted right away, unless it is a
+     real-time thread. */
+  if (running_thread () != rq->idle_thread
+      && running_thread ()->sched_policy == SCHED_OTHER)
+    {
+      THREAD_TRACE (SCHED_EV_BOOST, running_thread (),
+                    running_thread ()->mlfq_priority, MLFQ_PRIORITY_MAX);
+      mlfq_apply_boost (running_thread ());
+    }
+}
+
+/* Brings T's MLFQ state up to date with the last boost: if a
+   boost happened since T last checked, T moves to the top
+   priority with a fresh quantum.  Real-time threads are exempt.
+   Interrupts must be off. */
+static void
+mlfq_apply_boost (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (t->sched_policy != SCHED_OTHER)
+    return;
+
+  if (mlfq_policy_apply_boost (mlfq_boost_epoch, &t->mlfq_priority,
+                               &t->ticks_at_priority, &t->boost_epoch))
+    {
+#ifdef SCHED_STATS
+      boosted_threads++;
+#endif
+    }
+}
+/* ============================================================================ */
+
+/* Returns the MLFQ ready mask of the running CPU: bit I is set
+   iff some thread is ready at MLFQ priority I.  Interrupts should
+   be off if the caller needs the answer to stay valid. */
+uint32_t
+thread_mlfq_ready_mask (void)
+{
+  return this_rq ()->mlfq_ready_mask;
+}
+
+/* Returns true if a thread at a scheduling level strictly higher
+   than PRIORITY, which may be a real-time level, is ready to run
+   on the running CPU and may preempt the running thread there
+   (see mlfq_preempt_mask()). */
+bool
+thread_mlfq_higher_ready (int priority)
+{
+  ASSERT (priority >= MLFQ_PRIORITY_MIN && priority < SCHED_NUM_LEVELS);
+
+  return (mlfq_preempt_mask (this_rq ()) >> priority >> 1) != 0;
+}
+
+/* Boosts every thread to the top MLFQ priority now, exactly as
+   the periodic boost in thread_tick() does, and without moving
+   the next periodic boost.  Used by the scheduler benchmarks to
+   time a boost. */
+void
+thread_mlfq_boost (void)
+{
+  enum intr_level old_level;
+
+  ASSERT (thread_mlfqs);
+
+  old_level = intr_disable ();
+  mlfq_boost_epoch++;
+  mlfq_boost_all (this_rq ());
+  intr_set_level (old_level);
+}
+
+/* Returns the scheduling level that T competes at: its real-time
+   level or MLFQ priority, counting a boost that T has not applied
+   yet because it was blocked when the boost happened, or a higher
+   level donated to it. */
+int
+thread_mlfq_effective_priority (const struct thread *t)
+{
+  int priority = t->mlfq_priority;
+
+  if (t->sched_policy != SCHED_OTHER)
+    priority = RT_LEVEL_BASE + t->rt_priority;
+  else if (t->boost_epoch != mlfq_boost_epoch)
+    priority = MLFQ_PRIORITY_MAX;
+  return t->mlfq_donated > priority ? t->mlfq_donated : priority;
+}
+
+/* Under the MLFQ scheduler, makes the running thread give way to
+   T, which has just been made ready, if T outranks it: at once
+   in thread context, or when the current interrupt handler
+   returns.  Does nothing otherwise.  Interrupts must have stayed
+   off since T was made ready, or T could already have run and
+   exited. */
+void
+thread_preempt_for (struct thread *t)
+{
+  struct thread *cur = running_thread ();
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!thread_mlfqs)
+    return;
+  if (cur == this_rq ()->idle_thread)
+    {
+      /* The idle thread blocks again on its own. */
+      if (intr_context ())
+        request_preempt ();
+      return;
+    }
+  if (thread_mlfq_effective_priority (t)
+      <= thread_mlfq_effective_priority (cur))
+    return;
+
+  /* A time-sharing thread of another group waits for the end of
+     the running thread's quantum (see mlfq_preempt_mask()). */
+  if (thread_mlfq_effective_priority (t) <= MLFQ_PRIORITY_MAX
+      && t->group != cur->group)
+    return;
+
+  if (intr_context ())
+    request_preempt ();
+  else
+    thread_yield ();
+}
+
+/* Adds T to the back of RQ's queue for its scheduling level and
+   marks that queue non-empty.  A group that had nothing ready
+   catches its pass up to the group dispatched last, so that it
+   cannot bank the time it spent idle against the busy groups.
+   Interrupts must be off. */
+static void
+mlfq_enqueue (struct runqueue *rq, struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  t->mlfq_queue = mlfq_level (t);
+  list_push_back (mlfq_queue_for (rq, t->group, t->mlfq_queue),
+                  &t->mlfq_elem);
+  if (t->mlfq_queue <= MLFQ_PRIORITY_MAX)
+    {
+      struct group_queues *gq = &rq->groups[t->group];
+      struct sched_group *group = &sched_groups[t->group];
+
+      if (gq->ready_mask == 0 && group->pass < rq->group_pass)
+        group->pass = rq->group_pass;
+      gq->ready_mask |= 1u << t->mlfq_queue;
+    }
+  rq->mlfq_ready_mask |= 1u << t->mlfq_queue;
+  t->ready_since = timer_ticks ();
+#ifdef SCHED_STATS
+  if (++rq->mlfq_queue_len[t->mlfq_queue] > queue_high_water[t->mlfq_queue])
+    queue_high_water[t->mlfq_queue] = rq->mlfq_queue_len[t->mlfq_queue];
+#endif
+}
+
+/* Takes ready thread T out of its queue on RQ.  Interrupts must
+   be off. */
+static void
+mlfq_remove (struct runqueue *rq, struct thread *t)
+{
+  int i = t->mlfq_queue;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (t->status == THREAD_READY);
+
+  /* A boost spliced every MLFQ queue into the top one after T was
+     queued. */
+  if (i <= MLFQ_PRIORITY_MAX && t->boost_epoch != rq->boost_epoch)
+    i = MLFQ_PRIORITY_MAX;
+
+  list_remove (&t->mlfq_elem);
+  mlfq_queue_emptied (rq, t->group, i);
+#ifdef SCHED_STATS
+  rq->mlfq_queue_len[i]--;
+#endif
+}
+
+/* Moves the first thread of each of RQ's queues below the top
+   whose own priority is that level up one level, if it has been
+   ready for at least its level's maxwait ticks.  Threads queued
+   there only by donation are skipped, since a donation is no
+   reason to hold back the threads behind it.  Each queue is FIFO,
+   so if that thread has not waited long enough, nothing behind it
+   has either.  Interrupts must be off. */
+static void
+mlfq_promote_starved (struct runqueue *rq)
+{
+  int64_t now = timer_ticks ();
+  int g, i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (g = 0; g < sched_group_cnt; g++)
+    for (i = MLFQ_PRIORITY_MAX - 1; i >= MLFQ_PRIORITY_MIN; i--)
+      {
+        int maxwait = mlfq_dispatch_table[i].maxwait;
+        struct list *queue = &rq->groups[g].mlfq_queues[i];
+        struct list_elem *e;
+        struct thread *t = NULL;
+
+        if (maxwait == 0 || (rq->groups[g].ready_mask & (1u << i)) == 0)
+          continue;
+        for (e = list_begin (queue); e != list_end (queue);
+             e = list_next (e))
+          {
+            t = list_entry (e, struct thread, mlfq_elem);
+            if (t->mlfq_priority == i)
+              break;
+          }
+        if (e == list_end (queue) || now - t->ready_since < maxwait)
+          continue;
+
+        mlfq_remove (rq, t);
+        t->mlfq_priority = i + 1;
+        t->ticks_at_priority = 0;
+        mlfq_enqueue (rq, t);
+      }
+}
+
+/* Returns the level that T, waking from a SLEPT-tick
+   timer_sleep() at LEVEL, should resume at, and resets T's count
+   of ticks run since it last slept.  Without sleep credit that is
+   LEVEL.  With it, T moves up one level for each multiple of the
+   ticks it ran before sleeping that it slept, up to
+   MLFQ_SLEEP_CREDIT_MAX levels.  The
+   sleep must last at least LEVEL's quantum to count, so that a
+   thread cannot keep its place by sleeping for a tick just before
+   its quantum runs out.  Interrupts must be off. */
+int
+thread_mlfq_wake_level (struct thread *t, int level, int64_t slept)
+{
+  int ran = t->ticks_since_sleep;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  t->ticks_since_sleep = 0;
+  if (!mlfq_sleep_credit)
+    return level;
+  return mlfq_policy_sleep_credit (mlfq_dispatch_table, level, slept, ran);
+}
+
+/* With adaptive boosting, boosts each of RQ's levels below the
+   top whose head has been ready for mlfq_starvation_threshold()
+   ticks or more.  Interrupts must be off. */
+static void
+mlfq_boost_starved (struct runqueue *rq)
+{
+  int64_t now = timer_ticks ();
+  int64_t threshold = mlfq_starvation_threshold ();
+  int g;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (g = 0; g < sched_group_cnt; g++)
+    {
+      struct group_queues *gq = &rq->groups[g];
+      uint32_t low = gq->ready_mask & ~(1u << MLFQ_PRIORITY_MAX);
+
+      while (low != 0)
         {
-          /* Took thread from current queue */
-          e = list_pop_front (&mlfq_queues[i]);
-          t = list_entry (e, struct thread, mlfq_elem);
-          
-          /* Boost to highest priority and reset tick counter */
-          t->mlfq_priority = MLFQ_PRIORITY_MAX;
-          t->ticks_at_priority = 0;
-          
-          /* Added to highest priority queue */
-          list_push_back (&mlfq_queues[MLFQ_PRIORITY_MAX], &t->mlfq_elem);
+          int i = mlfq_policy_pick (low);
+          struct thread *head = list_entry (list_front (&gq->mlfq_queues[i]),
+                                            struct thread, mlfq_elem);
+
+          low &= ~(1u << i);
+          if (now - head->ready_since >= threshold)
+            mlfq_boost_level (rq, g, i);
         }
     }
-  
-  /* ======================================================================== */
-  for (e = list_begin (&all_list); e != list_end (&all_list); e = list_next (e))
+}
+
+/* Moves every thread in GROUP's queue LEVEL on RQ to the top
+   priority with a fresh quantum.  Interrupts must be off. */
+static void
+mlfq_boost_level (struct runqueue *rq, int group, int level)
+{
+  struct group_queues *gq = &rq->groups[group];
+  struct list *queue = &gq->mlfq_queues[level];
+  struct list *top = &gq->mlfq_queues[MLFQ_PRIORITY_MAX];
+  struct list_elem *e;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (level < MLFQ_PRIORITY_MAX);
+
+  for (e = list_begin (queue); e != list_end (queue); e = list_next (e))
+    {
+      struct thread *t = list_entry (e, struct thread, mlfq_elem);
+
+      t->mlfq_priority = MLFQ_PRIORITY_MAX;
+      t->ticks_at_priority = 0;
+      t->mlfq_queue = MLFQ_PRIORITY_MAX;
+#ifdef SCHED_STATS
+      boosted_threads++;
+#endif
+    }
+  list_splice (list_end (top), list_begin (queue), list_end (queue));
+  mlfq_queue_emptied (rq, group, level);
+  gq->ready_mask |= 1u << MLFQ_PRIORITY_MAX;
+  rq->mlfq_ready_mask |= 1u << MLFQ_PRIORITY_MAX;
+#ifdef SCHED_STATS
+  boosts++;
+  rq->mlfq_queue_len[MLFQ_PRIORITY_MAX] += rq->mlfq_queue_len[level];
+  rq->mlfq_queue_len[level] = 0;
+  if (rq->mlfq_queue_len[MLFQ_PRIORITY_MAX]
+      > queue_high_water[MLFQ_PRIORITY_MAX])
+    queue_high_water[MLFQ_PRIORITY_MAX]
+      = rq->mlfq_queue_len[MLFQ_PRIORITY_MAX];
+#endif
+}
+
+/* Returns how many ticks a thread below the top queue may wait
+   before adaptive boosting boosts its level.  It is half the boost
+   interval on an idle system, the full interval at a load average
+   of 1, and grows in proportion beyond that: with more threads
+   competing, each one is expected to wait longer for its turn, so
+   only waits well past that share count as starvation. */
+static int64_t
+mlfq_starvation_threshold (void)
+{
+  return mlfq_policy_starvation_threshold (mlfq_boost_interval, load_avg);
+}
+
+/* Sets dispatch table entries from the -mlfqs-table option VALUE:
+   a comma-separated list of LEVEL:QUANTUM:TQEXP:SLPRET:MAXWAIT
+   entries, each replacing the entry for LEVEL.  Levels not named
+   keep their default.  Returns false, having possibly set some
+   entries, if VALUE is malformed or out of range. */
+bool
+thread_mlfq_parse_table (const char *value)
+{
+  int i;
+
+  mlfq_starvation_checks = false;
+  for (;;)
+    {
+      int f[5];
+
+      for (i = 0; i < 5; i++)
+        if (!parse_int (&value, &f[i])
+            || (i < 4 && *value++ != ':'))
+          return false;
+      if (f[0] < MLFQ_PRIORITY_MIN || f[0] > MLFQ_PRIORITY_MAX
+          || f[1] < 1
+          || f[2] < MLFQ_PRIORITY_MIN || f[2] > MLFQ_PRIORITY_MAX
+          || f[3] < MLFQ_PRIORITY_MIN || f[3] > MLFQ_PRIORITY_MAX
+          || f[4] < 0)
+        return false;
+      mlfq_dispatch_table[f[0]].quantum = f[1];
+      mlfq_dispatch_table[f[0]].tqexp = f[2];
+      mlfq_dispatch_table[f[0]].slpret = f[3];
+      mlfq_dispatch_table[f[0]].maxwait = f[4];
+
+      if (*value == '\0')
+        break;
+      if (*value++ != ',')
+        return false;
+    }
+
+  for (i = MLFQ_PRIORITY_MIN; i <= MLFQ_PRIORITY_MAX; i++)
+    if (mlfq_dispatch_table[i].maxwait != 0)
+      mlfq_starvation_checks = true;
+  return true;
+}
+
+/* Parses a nonnegative decimal integer at *S into *VALUE and
+   advances *S past it.  Returns false if *S does not start with a
+   digit. */
+static bool
+parse_int (const char **s, int *value)
+{
+  if (**s < '0' || **s > '9')
+    return false;
+  *value = 0;
+  while (**s >= '0' && **s <= '9')
+    *value = *value * 10 + (*(*s)++ - '0');
+  return true;
+}
+
+/* Returns the scheduling level that T, whose pending boost if
+   any has been applied, belongs in: its real-time level or MLFQ
+   priority, or its donated level, whichever is higher. */
+static int
+mlfq_level (const struct thread *t)
+{
+  int level = (t->sched_policy != SCHED_OTHER
+               ? RT_LEVEL_BASE + t->rt_priority : t->mlfq_priority);
+
+  return t->mlfq_donated > level ? t->mlfq_donated : level;
+}
+
+/* Sets the MLFQ level donated to T to LEVEL, or MLFQ_NO_DONATION,
+   moving T to the matching queue if it is ready.  Interrupts must
+   be off. */
+static void
+mlfq_set_donation (struct thread *t, int level)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (t->mlfq_donated == level)
+    return;
+  if (t->status == THREAD_READY)
+    {
+      struct runqueue *rq = this_rq ();
+
+      mlfq_remove (rq, t);
+      t->mlfq_donated = level;
+      mlfq_apply_boost (t);
+      mlfq_enqueue (rq, t);
+    }
+  else
+    t->mlfq_donated = level;
+}
+
+/* Returns the highest effective MLFQ priority among the threads
+   waiting for LOCK, or MLFQ_NO_DONATION if there are none.
+   Interrupts must be off. */
+static int
+mlfq_max_waiter (struct lock *lock)
+{
+  struct list *waiters = &lock->semaphore.waiters;
+  struct list_elem *e;
+  int level = MLFQ_NO_DONATION;
+
+  for (e = list_begin (waiters); e != list_end (waiters); e = list_next (e))
+    {
+      int priority
+        = thread_mlfq_effective_priority (list_entry (e, struct thread, elem));
+      if (priority > level)
+        level = priority;
+    }
+  return level;
+}
+
+/* Called by lock_acquire() with interrupts off when the running
+   thread is about to wait for LOCK, which another thread holds.
+   Donates the running thread's MLFQ level to the holder, and on
+   down the chain of holders that are themselves waiting for a
+   lock, so that none of them runs below the waiter. */
+void
+thread_mlfq_donate (struct lock *lock)
+{
+  struct thread *cur = thread_current ();
+  int level = thread_mlfq_effective_priority (cur);
+  int depth;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  cur->waiting_lock = lock;
+  for (depth = 0; depth < MLFQ_DONATION_DEPTH; depth++)
+    {
+      struct thread *holder = lock->holder;
+
+      if (holder == NULL || thread_mlfq_effective_priority (holder) >= level)
+        break;
+      mlfq_set_donation (holder, level);
+      lock = holder->waiting_lock;
+      if (lock == NULL)
+        break;
+    }
+}
+
+/* Called by lock_acquire() and lock_try_acquire() with interrupts
+   off once the running thread holds LOCK.  Threads still waiting
+   for LOCK now donate to the running thread. */
+void
+thread_mlfq_lock_acquired (struct lock *lock)
+{
+  struct thread *cur = thread_current ();
+  int level;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  cur->waiting_lock = NULL;
+  list_push_back (&cur->held_locks, &lock->elem);
+  level = mlfq_max_waiter (lock);
+  if (level > cur->mlfq_donated)
+    cur->mlfq_donated = level;
+}
+
+/* Called by lock_release() with interrupts off before the running
+   thread gives up LOCK.  Recomputes the level donated to the
+   running thread from the locks it still holds, and returns true
+   if its effective priority dropped, in which case the caller
+   should let a higher thread run. */
+bool
+thread_mlfq_lock_released (struct lock *lock)
+{
+  struct thread *cur = thread_current ();
+  int before = mlfq_level (cur);
+  int level = MLFQ_NO_DONATION;
+  struct list_elem *e;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  list_remove (&lock->elem);
+  for (e = list_begin (&cur->held_locks); e != list_end (&cur->held_locks);
+       e = list_next (e))
+    {
+      int waiter = mlfq_max_waiter (list_entry (e, struct lock, elem));
+      if (waiter > level)
+        level = waiter;
+    }
+  cur->mlfq_donated = level;
+  return mlfq_level (cur) < before;
+}
+
+/* Removes and returns the first thread of RQ's highest non-empty
+   queue that may be dispatched, with any pending boost applied:
+   a real-time queue if one may run, otherwise the highest
+   non-empty queue of the group that mlfq_pick_group() picks.
+   At least one queue must be non-empty.  Interrupts must be
+   off. */
+static struct thread *
+mlfq_dequeue_highest (struct runqueue *rq)
+{
+  int group = SCHED_GROUP_DEFAULT;
+  int i;
+  struct list_elem *e;
+  struct thread *t;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (rq->mlfq_ready_mask != 0);
+
+  i = mlfq_policy_pick (mlfq_dispatch_mask (rq));
+  if (i <= MLFQ_PRIORITY_MAX)
+    {
+      group = mlfq_pick_group (rq);
+      i = mlfq_policy_pick (rq->groups[group].ready_mask);
+      rq->group_pass = sched_groups[group].pass;
+    }
+  e = list_pop_front (mlfq_queue_for (rq, group, i));
+  mlfq_queue_emptied (rq, group, i);
+  t = list_entry (e, struct thread, mlfq_elem);
+#ifdef SCHED_STATS
+  rq->mlfq_queue_len[i]--;
+  t->ready_ticks += timer_ticks () - t->ready_since;
+#endif
+  mlfq_apply_boost (t);
+  return t;
+}
+
+/* Returns RQ's queue for scheduling LEVEL: GROUP's MLFQ queue,
+   or above MLFQ_PRIORITY_MAX a real-time one, which every group
+   shares. */
+static struct list *
+mlfq_queue_for (struct runqueue *rq, int group, int level)
+{
+  ASSERT (level >= MLFQ_PRIORITY_MIN && level < SCHED_NUM_LEVELS);
+  ASSERT (group >= 0 && group < sched_group_cnt);
+
+  return (level > MLFQ_PRIORITY_MAX
+          ? &rq->rt_queues[level - RT_LEVEL_BASE]
+          : &rq->groups[group].mlfq_queues[level]);
+}
+
+/* Clears the ready bits for RQ's queue for GROUP and LEVEL if
+   that queue is empty.  LEVEL's bit in the run queue's own mask
+   stays set while another group has threads at LEVEL. */
+static void
+mlfq_queue_emptied (struct runqueue *rq, int group, int level)
+{
+  uint32_t bit = 1u << level;
+  int g;
+
+  if (!list_empty (mlfq_queue_for (rq, group, level)))
+    return;
+  if (level <= MLFQ_PRIORITY_MAX)
+    {
+      rq->groups[group].ready_mask &= ~bit;
+      for (g = 0; g < sched_group_cnt; g++)
+        if (rq->groups[g].ready_mask & bit)
+          return;
+    }
+  rq->mlfq_ready_mask &= ~bit;
+}
+
+/* Returns the group with the lowest pass among those with MLFQ
+   threads ready on RQ, the lowest-numbered one on a tie.  Some
+   MLFQ queue must be non-empty. */
+static int
+mlfq_pick_group (const struct runqueue *rq)
+{
+  int best = -1;
+  int g;
+
+  for (g = 0; g < sched_group_cnt; g++)
+    if (rq->groups[g].ready_mask != 0
+        && (best < 0 || sched_groups[g].pass < sched_groups[best].pass))
+      best = g;
+  ASSERT (best >= 0);
+  return best;
+}
+
+/* Returns the bits of RQ's ready mask that the dispatcher may
+   pick from: all of them, except that while the real-time class
+   is throttled and some MLFQ thread is ready, only the MLFQ
+   levels. */
+static uint32_t
+mlfq_dispatch_mask (const struct runqueue *rq)
+{
+  uint32_t mlfq = rq->mlfq_ready_mask & MLFQ_LEVELS_MASK;
+
+  return rq->rt_throttled && mlfq != 0 ? mlfq : rq->mlfq_ready_mask;
+}
+
+/* Returns the bits of RQ's ready mask whose threads may preempt
+   the running thread as soon as they outrank it: the real-time
+   levels that may be dispatched, and the MLFQ levels of the
+   running thread's own group.  Threads of other groups wait for
+   the running thread's quantum to end, when the dispatcher weighs
+   the groups by stride; checking them on every tick would switch
+   back and forth between groups each tick. */
+static uint32_t
+mlfq_preempt_mask (const struct runqueue *rq)
+{
+  const struct thread *cur = running_thread ();
+  uint32_t mask = mlfq_dispatch_mask (rq);
+
+  if (sched_group_cnt == 1 || cur == rq->idle_thread)
+    return mask;
+  return ((mask & ~MLFQ_LEVELS_MASK)
+          | (mask & rq->groups[cur->group].ready_mask));
+}
+
+/* Returns true if schedule() would pick running thread CUR again
+   were it to yield on RQ now: no queue at or above CUR's level
+   has a thread in it (a thread at CUR's own level still gets its
+   turn), CUR is not a real-time thread that the throttle holds
+   back, and no other group could win the MLFQ levels below. */
+static bool
+mlfq_yield_keeps_cpu (const struct runqueue *rq, const struct thread *cur)
+{
+  uint32_t mlfq = rq->mlfq_ready_mask & MLFQ_LEVELS_MASK;
+  int level = mlfq_level (cur);
+
+  if ((mlfq_dispatch_mask (rq) >> level) != 0)
+    return false;
+  if (level > MLFQ_PRIORITY_MAX)
+    return !rq->rt_throttled || mlfq == 0;
+  return sched_group_cnt == 1 || mlfq == 0;
+}
+
+/* Returns the run queue. */
+static struct runqueue *
+this_rq (void)
+{
+  return &runqueue;
+}
+
+#ifdef SCHED_TRACE
+/* Records an event of the given TYPE for thread T, which moved
+   from OLD_PRIORITY to NEW_PRIORITY, in the trace ring.  The
+   oldest event is overwritten once the ring is full.  Interrupts
+   must be off. */
+void
+thread_trace (enum sched_event_type type, const struct thread *t,
+              int old_priority, int new_priority)
+{
+  struct sched_event *e;
+
+  e = &sched_trace_buf[sched_trace_next++ & (SCHED_TRACE_SIZE - 1)];
+  e->tick = idle_ticks + kernel_ticks + user_ticks;
+  e->tid = t->tid;
+  e->type = type;
+  e->old_priority = old_priority;
+  e->new_priority = new_priority;
+}
+
+/* Writes the trace ring to the serial port, oldest event first,
+   in the raw little-endian layout of struct sched_event.  The
+   dump is framed by a 16-byte header: the magic "SCHTRACE", the
+   number of events that follow, and the number recorded since
+   boot (more than that if older events were overwritten), each
+   as a 32-bit little-endian word. */
+void
+thread_trace_dump (void)
+{
+  enum intr_level old_level;
+  uint32_t total, count, first, i;
+  const char *magic = "SCHTRACE";
+  uint32_t words[2];
+  const uint8_t *p;
+
+  printf ("Scheduler: dumping trace events to serial\n");
+
+  old_level = intr_disable ();
+  serial_flush ();
+  total = sched_trace_next;
+  count = total < SCHED_TRACE_SIZE ? total : SCHED_TRACE_SIZE;
+  first = total - count;
+
+  for (p = (const uint8_t *) magic; *p != '\0'; p++)
+    serial_putc (*p);
+  words[0] = count;
+  words[1] = total;
+  for (p = (const uint8_t *) words; p < (const uint8_t *) (words + 2); p++)
+    serial_putc (*p);
+  for (i = first; i != total; i++)
     {
-      t = list_entry (e, struct thread, allelem);
-      if (t != idle_thread)
+      const struct sched_event *e
+        = &sched_trace_buf[i & (SCHED_TRACE_SIZE - 1)];
+      for (p = (const uint8_t *) e; p < (const uint8_t *) (e + 1); p++)
+        serial_putc (*p);
+    }
+  serial_flush ();
+  intr_set_level (old_level);
+}
+#endif
+
+#ifdef INTR_PROFILE
+/* Opens an interrupts-off window for SITE.  Interrupts must have
+   just been turned off. */
+void
+intr_profile_begin (struct intr_profile_site *site)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  intr_profile_open = site;
+  intr_profile_start = rdtsc ();
+}
+
+/* Closes the open interrupts-off window, if any, and charges its
+   length to the site that opened it.  Interrupts must still be
+   off. */
+void
+intr_profile_end (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (intr_profile_open != NULL)
+    {
+      intr_profile_record (intr_profile_open, rdtsc () - intr_profile_start);
+      intr_profile_open = NULL;
+    }
+}
+
+/* Adds a window of CYCLES to SITE's totals.  Interrupts must be
+   off. */
+void
+intr_profile_record (struct intr_profile_site *site, uint64_t cycles)
+{
+  if (!site->registered)
+    {
+      site->registered = true;
+      site->next = intr_profile_sites;
+      intr_profile_sites = site;
+    }
+  site->count++;
+  site->total_cycles += cycles;
+  if (cycles > site->max_cycles)
+    site->max_cycles = cycles;
+}
+
+/* Prints the INTR_PROFILE_REPORT sites with the longest
+   interrupts-off windows, longest first. */
+void
+intr_profile_print (void)
+{
+  struct intr_profile_site worst[INTR_PROFILE_REPORT];
+  struct intr_profile_site *s;
+  enum intr_level old_level;
+  int n = 0;
+  int i;
+
+  /* Take a sorted snapshot first: printf() may not be called
+     with interrupts off. */
+  old_level = intr_disable ();
+  for (s = intr_profile_sites; s != NULL; s = s->next)
+    {
+      for (i = n; i > 0 && worst[i - 1].max_cycles < s->max_cycles; i--)
+        if (i < INTR_PROFILE_REPORT)
+          worst[i] = worst[i - 1];
+      if (i < INTR_PROFILE_REPORT)
+        worst[i] = *s;
+      if (n < INTR_PROFILE_REPORT)
+        n++;
+    }
+  intr_set_level (old_level);
+
+  printf ("Interrupts off: longest windows, in TSC cycles\n");
+  for (i = 0; i < n; i++)
+    printf ("Interrupts off: %s:%d: max %llu, mean %llu, %u windows\n",
+            worst[i].function, worst[i].line, worst[i].max_cycles,
+            worst[i].total_cycles / worst[i].count, worst[i].count);
+}
+#endif
+
+/* Returns a zeroed page for a new thread, from the page cache
+   if it has one, otherwise from palloc.  Returns a null pointer
+   if no memory is available. */
+static struct thread *
+page_cache_get (void)
+{
+  struct cached_page *page = NULL;
+  bool dirty = false;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  if (!list_empty (&clean_pages))
+    page = list_entry (list_pop_front (&clean_pages),
+                       struct cached_page, elem);
+  else if (!list_empty (&dirty_pages))
+    {
+      page = list_entry (list_pop_front (&dirty_pages),
+                         struct cached_page, elem);
+      dirty = true;
+    }
+  if (page == NULL)
+    page_cache_misses++;
+  else
+    {
+      page_cache_cnt--;
+      if (dirty)
+        page_cache_dirty_hits++;
+      else
+        page_cache_hits++;
+    }
+  intr_set_level (old_level);
+
+  if (page == NULL)
+    return palloc_get_page (PAL_ZERO);
+  memset (page, 0, dirty ? PGSIZE : sizeof *page);
+  return (struct thread *) page;
+}
+
+/* Takes back dying thread T's page, keeping it for reuse unless
+   the cache is full.  Called from thread_schedule_tail() with
+   interrupts off. */
+static void
+page_cache_put (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (page_cache_cnt < THREAD_PAGE_CACHE_SIZE)
+    {
+      struct cached_page *page = (struct cached_page *) t;
+
+      list_push_back (&dirty_pages, &page->elem);
+      page_cache_cnt++;
+    }
+  else
+    palloc_free_page (t);
+}
+
+/* Zeroes the cache's dirty pages, one at a time with interrupts
+   on so that a wakeup can preempt the idle thread mid-page. */
+static void
+page_cache_scrub (void)
+{
+  for (;;)
+    {
+      struct cached_page *page;
+      enum intr_level old_level;
+
+      old_level = intr_disable ();
+      if (list_empty (&dirty_pages))
         {
-          t->mlfq_priority = MLFQ_PRIORITY_MAX;
-          t->ticks_at_priority = 0;
+          intr_set_level (old_level);
+          return;
         }
+      page = list_entry (list_pop_front (&dirty_pages),
+                         struct cached_page, elem);
+      intr_set_level (old_level);
+
+      memset (page, 0, PGSIZE);
+
+      intr_disable ();
+      list_push_back (&clean_pages, &page->elem);
+      intr_set_level (old_level);
     }
 }
-/* ============================================================================ */
+
+/* Runs the work that the timer interrupt leaves for when it
+   yields, after its handler has returned: applying a new boost to
+   this CPU's queues and waking the sleepers that came due.  Doing
+   it here rather than in the handler keeps interrupt latency
+   down, and lets a tick on which many sleepers are due wake them
+   all before one decision whether to switch.  Returns true if
+   there was any.  Interrupts must be off. */
+static bool
+run_deferred_work (void)
+{
+  struct runqueue *rq = this_rq ();
+  bool boosted = false;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (thread_mlfqs && rq->boost_epoch != mlfq_boost_epoch)
+    {
+      INTR_PROFILE_SPAN_BEGIN (boost_start);
+      mlfq_boost_all (rq);
+      INTR_PROFILE_SPAN_END (boost_start);
+      boosted = true;
+    }
+  return timer_run_wakeups () || boosted;
+}
+
+/* Changes T's status to STATUS, moving it to that state's list.
+   Interrupts must be off. */
+static void
+set_status (struct thread *t, enum thread_status status)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  list_remove (&t->stateelem);
+  state_counts[t->status]--;
+  t->status = status;
+  list_push_back (&state_lists[status], &t->stateelem);
+  state_counts[status]++;
+}
+
+/* Asks for the running thread to be preempted when the current
+   interrupt handler returns. */
+static void
+request_preempt (void)
+{
+  preemptions++;
+  preempt_requested = true;
+#ifdef SCHED_STATS
+  preempt_pending = true;
+#endif
+  intr_yield_on_return ();
+}
@@ -3,7 +3,9 @@
 
 #include <debug.h>
 #include <list.h>
+#include <stddef.h>
 #include <stdint.h>
+#include "threads/mlfq-policy.h"
 
 /* States in a thread's life cycle. */
 enum thread_status
@@ -24,14 +26,82 @@ typedef int tid_t;
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
 
+/* Thread niceness. */
+#define NICE_MIN -20                    /* Nicest. */
+#define NICE_DEFAULT 0                  /* Default niceness. */
+#define NICE_MAX 20                     /* Least nice. */
+
 /* ========================================================================== */
 /* added lines for LAB 4: MLFQ constants                                            */
-/* we need these to define our 20 priority queues (0-19) and boost interval  */
+/* The 20 priority queues (0-19), boost interval and dispatch table  */
+/* are defined in threads/mlfq-policy.h.                                      */
 /* ========================================================================== */
-#define MLFQ_PRIORITY_MAX 19            /* highest MLFQ priority (queue 19). */
-#define MLFQ_PRIORITY_MIN 0             /* lowest MLFQ priority (queue 0). */
-#define MLFQ_NUM_QUEUES 20              /* total number of priority queues. */
-#define MLFQ_BOOST_INTERVAL 50          /* boost all threads every 50 ticks. */
+#define MLFQ_NO_DONATION (MLFQ_PRIORITY_MIN - 1) /* mlfq_donated if none. */
+
+extern struct mlfq_dispatch mlfq_dispatch_table[MLFQ_NUM_QUEUES];
+extern int mlfq_boost_interval;
+extern bool mlfq_adaptive_boost;
+extern bool mlfq_sleep_credit;
+#define MLFQ_DONATION_DEPTH 8           /* longest lock chain donated along. */
+
+/* Scheduling classes.  Under the MLFQ scheduler a thread may run
+   in a real-time class instead of time sharing, at a fixed
+   priority from RT_PRIORITY_MIN to RT_PRIORITY_MAX that puts it
+   above every MLFQ level, at scheduling level RT_LEVEL_BASE plus
+   that priority.  Real-time threads have queues of their own and
+   are never demoted or boosted.  A SCHED_FIFO thread runs until
+   it blocks or yields or a higher level preempts it; a SCHED_RR
+   thread also takes turns with its level every RT_TIME_SLICE
+   ticks.  While MLFQ threads are ready, real-time threads
+   together get at most rt_share percent of each second. */
+enum sched_policy
+  {
+    SCHED_OTHER,        /* MLFQ time sharing. */
+    SCHED_FIFO,         /* Real time, first in first out. */
+    SCHED_RR            /* Real time, round robin. */
+  };
+#define RT_PRIORITY_MIN 0               /* lowest real-time priority. */
+#define RT_PRIORITY_MAX 7               /* highest real-time priority. */
+#define RT_LEVEL_BASE (MLFQ_PRIORITY_MAX + 1) /* level of RT_PRIORITY_MIN. */
+#define SCHED_NUM_LEVELS (RT_LEVEL_BASE + RT_PRIORITY_MAX + 1)
+#define RT_TIME_SLICE 4                 /* SCHED_RR ticks per turn. */
+extern int rt_share;
+
+/* Scheduling groups.  Under the MLFQ scheduler every time-sharing
+   thread belongs to a group, group 0 (SCHED_GROUP_DEFAULT) unless
+   it or its creator joined another with thread_set_group().  When
+   threads of several groups are ready, the dispatcher picks a
+   group by stride scheduling, so that over time each busy group
+   gets CPU in proportion to its weight however many threads it
+   has, and then the group's best thread by the usual MLFQ rules.
+   Real-time threads rank above every group. */
+#define SCHED_GROUP_MAX 8               /* most groups, including default. */
+#define SCHED_GROUP_DEFAULT 0           /* group of the initial thread. */
+#define SCHED_GROUP_WEIGHT_DEFAULT 100  /* weight of the default group. */
+#define SCHED_GROUP_WEIGHT_MAX 10000    /* largest group weight. */
+
+/* thread_tick() only preempts when the running thread's quantum
+   expires, a boost happens, or a higher-priority thread is ready.
+   Define MLFQ_PREEMPT_EVERY_TICK to switch on every tick instead,
+   e.g. to compare the "context switches" line that
+   thread_print_stats() prints at shutdown. */
+/* #define MLFQ_PREEMPT_EVERY_TICK */
+
+/* Define SCHED_STATS to compile in the scheduler counters that
+   thread_print_stats() reports: voluntary and involuntary
+   switches, demotions per level, boosts, queue-depth high-water
+   marks, and per-thread ready, running and per-priority ticks. */
+/* #define SCHED_STATS */
+
+/* Define SCHED_TRACE to record scheduler events into a ring
+   buffer that thread_print_stats() dumps in binary over the
+   serial port at shutdown (see thread_trace_dump()). */
+/* #define SCHED_TRACE */
+
+/* Define INTR_PROFILE to time interrupts-off sections with the
+   TSC and report the longest per call site at shutdown (see
+   threads/intr-profile.h). */
+/* #define INTR_PROFILE */
 /* ========================================================================== */
 
 /* A kernel thread or user process.
@@ -61,6 +131,7 @@ typedef int tid_t;
              |                :                |
              |                :                |
              |               name              |
+             |                :                |
              |              status             |
         0 kB +---------------------------------+
 
@@ -89,19 +160,33 @@ typedef int tid_t;
    semaphore wait list (synch.c).  It can be used these two ways
    only because they are mutually exclusive: only a thread in the
    ready state is on the run queue, whereas only a thread in the
-   blocked state is on a semaphore wait list. */
+   blocked state is on a semaphore wait list.
+
+   The members up to and including `elem' are the ones that
+   thread_tick(), next_thread_to_run() and schedule() touch on
+   every tick and switch.  They are kept together at the start of
+   the structure, which is page-aligned, so that they share the
+   first THREAD_HOT_BYTES-byte cache line; thread.c checks this at
+   compile time.  Colder members follow.  `magic' stays last
+   because it must sit where a stack overflow hits first.
+
+   Defining THREAD_SPREAD_LAYOUT puts the name, priority and list
+   links back among the hot members, where they used to be, so
+   that bench-ctxsw can compare the two layouts. */
+#define THREAD_HOT_BYTES 64
 struct thread
   {
     /* Owned by thread.c. */
-    tid_t tid;                          /* Thread identifier. */
     enum thread_status status;          /* Thread state. */
+#ifdef THREAD_SPREAD_LAYOUT
     char name[16];                      /* Name (for debugging purposes). */
-    uint8_t *stack;                     /* Saved stack pointer. */
     int priority;                       /* Priority. */
     struct list_elem allelem;           /* List element for all threads list. */
-
-    /* Shared between thread.c and synch.c. */
-    struct list_elem elem;              /* List element. */
+    struct list_elem stateelem;         /* List element for its state's list. */
+    struct list_elem tidelem;           /* List element for tid_buckets[]. */
+#endif
+    uint8_t *stack;                     /* Saved stack pointer. */
+    tid_t tid;                          /* Thread identifier. */
 
 /* ========================================================================== */
 /* addition#2: MLFQ scheduling fields                                    */
@@ -110,9 +195,45 @@ struct thread
 /* ========================================================================== */
     int mlfq_priority;                  /* our current MLFQ queue (0-19). */
     int ticks_at_priority;              /* how many ticks used at this priority. */
+    unsigned boost_epoch;               /* last boost applied to this thread. */
+    int mlfq_donated;                   /* highest level donated to us. */
+    int mlfq_queue;                     /* scheduling level we were last queued at. */
+    enum sched_policy sched_policy;     /* scheduling class. */
+    int rt_priority;                    /* real-time priority, unless SCHED_OTHER. */
+    int group;                          /* scheduling group. */
     struct list_elem mlfq_elem;         /* link for MLFQ queue lists. */
 /* ========================================================================== */
 
+    /* Shared between thread.c and synch.c. */
+    struct list_elem elem;              /* List element. */
+
+#ifndef THREAD_SPREAD_LAYOUT
+    /* Owned by thread.c. */
+    int priority;                       /* Priority. */
+    struct list_elem allelem;           /* List element for all threads list. */
+    struct list_elem stateelem;         /* List element for its state's list. */
+    struct list_elem tidelem;           /* List element for tid_buckets[]. */
+    char name[16];                      /* Name (for debugging purposes). */
+#endif
+
+    /* MLFQ priority donation, shared between thread.c and synch.c. */
+    struct lock *waiting_lock;          /* Lock we are waiting for. */
+    struct list held_locks;             /* Locks we hold. */
+
+    /* Owned by thread.c. */
+    int64_t ready_since;                /* Tick it last entered a ready queue. */
+    int ticks_since_sleep;              /* Ticks run since timer_sleep(). */
+    int nice;                           /* Niceness. */
+    fixed_point recent_cpu;             /* Ticks run lately, decayed each second. */
+    int64_t recent_cpu_second;          /* Last second decayed into recent_cpu. */
+
+#ifdef SCHED_STATS
+    /* Scheduler statistics, owned by thread.c. */
+    long long ready_ticks;              /* Ticks spent waiting in ready queues. */
+    long long run_ticks;                /* Ticks spent running. */
+    int priority_ticks[MLFQ_NUM_QUEUES]; /* Ticks run at each MLFQ priority. */
+#endif
+
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
     uint32_t *pagedir;                  /* Page directory. */
@@ -122,6 +243,13 @@ struct thread
     unsigned magic;                     /* Detects stack overflow. */
   };
 
+/* Bytes from the start of struct thread to the end of its hot
+   members, and the number of cache lines those bytes span. */
+#define THREAD_HOT_END \
+  (offsetof (struct thread, elem) + sizeof (struct list_elem))
+#define THREAD_HOT_LINES \
+  ((THREAD_HOT_END + THREAD_HOT_BYTES - 1) / THREAD_HOT_BYTES)
+
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
@@ -131,11 +259,16 @@ void thread_init (void);
 void thread_start (void);
 
 void thread_tick (void);
+void thread_skip_idle_ticks (int64_t);
 void thread_print_stats (void);
 
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority,
                      thread_func *, void *aux);
+tid_t thread_create_batch (int n, const char *name_fmt, int priority,
+                           thread_func *, void **aux);
+tid_t thread_create_rt (const char *name, enum sched_policy, int rt_priority,
+                        thread_func *, void *aux);
 
 void thread_block (void);
 void thread_unblock (struct thread *);
@@ -150,6 +283,9 @@ void thread_yield (void);
 /* Performs some operation on thread t, given auxiliary data AUX. */
 typedef void thread_action_func (struct thread *t, void *aux);
 void thread_foreach (thread_action_func *, void *);
+void thread_foreach_state (enum thread_status, thread_action_func *, void *);
+int thread_count_state (enum thread_status);
+struct thread *thread_find (tid_t);
 
 int thread_get_priority (void);
 void thread_set_priority (int);
@@ -159,4 +295,54 @@ void thread_set_nice (int);
 int thread_get_recent_cpu (void);
 int thread_get_load_avg (void);
 
+uint32_t thread_mlfq_ready_mask (void);
+bool thread_mlfq_higher_ready (int priority);
+void thread_mlfq_boost (void);
+void thread_set_sched (enum sched_policy, int rt_priority);
+int thread_group_create (const char *name, int weight);
+void thread_set_group (int group);
+int thread_get_group (void);
+int thread_mlfq_effective_priority (const struct thread *);
+bool thread_mlfq_parse_table (const char *);
+int thread_mlfq_wake_level (struct thread *, int level, int64_t slept);
+void thread_preempt_for (struct thread *);
+
+struct lock;
+void thread_mlfq_donate (struct lock *);
+void thread_mlfq_lock_acquired (struct lock *);
+bool thread_mlfq_lock_released (struct lock *);
+#ifdef SCHED_STATS
+int thread_get_priority_ticks (int priority);
+#endif
+
+/* Scheduler trace events. */
+enum sched_event_type
+  {
+    SCHED_EV_SWITCH,            /* schedule() switched to the thread. */
+    SCHED_EV_UNBLOCK,           /* thread_unblock() made it ready. */
+    SCHED_EV_DEMOTE,            /* thread_tick() moved it down a queue. */
+    SCHED_EV_BOOST,             /* mlfq_boost_all() ran while it was running. */
+    SCHED_EV_WAKEUP             /* timer_interrupt() woke it from a sleep. */
+  };
+
+/* One trace record, as dumped by thread_trace_dump(). */
+struct sched_event
+  {
+    uint32_t tick;              /* Low 32 bits of the timer tick. */
+    uint16_t tid;               /* Low 16 bits of the thread's tid. */
+    uint8_t type;               /* An enum sched_event_type. */
+    uint8_t old_priority;       /* MLFQ priority before the event. */
+    uint8_t new_priority;       /* MLFQ priority after the event. */
+    uint8_t pad[3];
+  };
+
+#ifdef SCHED_TRACE
+void thread_trace (enum sched_event_type, const struct thread *,
+                   int old_priority, int new_priority);
+void thread_trace_dump (void);
+#define THREAD_TRACE(TYPE, T, OLD, NEW) thread_trace (TYPE, T, OLD, NEW)
+#else
+#define THREAD_TRACE(TYPE, T, OLD, NEW) ((void) 0)
+#endif
+
 #endif /* threads/thread.h */
\ No newline at end of file
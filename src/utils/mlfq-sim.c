@@ -0,0 +1,778 @@
+/* mlfq-sim.c
+
+   Host-side simulator for the MLFQ scheduler.  It replays a
+   synthetic or traced workload against the same policy code that
+   the kernel runs (threads/mlfq-policy.h), one simulated timer
+   tick at a time but skipping over idle stretches, and reports
+   throughput, turnaround and response-time statistics.
+
+   Build from src/utils with:
+
+     cc -O2 -I.. -o mlfq-sim mlfq-sim.c
+
+   A workload is a set of tasks.  Each task arrives at some tick,
+   then runs for BURST ticks and sleeps in timer_sleep() for SLEEP
+   ticks, BURSTS times over, then exits.  A trace file gives one
+   task per line as "ARRIVAL BURST SLEEP BURSTS"; blank lines and
+   lines starting with `#' are ignored.
+
+   Compared with the kernel, the simulated CPU does no work other
+   than running tasks: there are no locks (and so no donation),
+   no interrupts-off latency and no context switch cost.  A task
+   that becomes ready above the running one preempts it at the
+   next tick, as the timer interrupt would.
+
+   With --cpus=N the simulator models the SMP scheduler that the
+   kernel cannot run until it brings up more than the boot CPU.
+   Each CPU has run queues of its own.  New tasks are spread over
+   the CPUs round robin, and woken tasks return to the CPU they
+   last ran on.  A CPU with nothing ready steals the first task of
+   the highest non-empty queue of a peer, as chosen by
+   mlfq_policy_steal_victim().  The boost clock advances the boost
+   epoch, and each CPU then splices only its own queues. */
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "threads/mlfq-policy.h"
+
+/* A simulated thread. */
+struct task
+  {
+    /* Workload. */
+    int64_t arrival;            /* Tick at which the task is created. */
+    int burst;                  /* Ticks run between sleeps. */
+    int sleep;                  /* Ticks slept after each burst. */
+    int bursts_left;            /* Bursts still to run. */
+    int run_left;               /* Ticks left in the current burst. */
+
+    /* MLFQ state, as in struct thread. */
+    int priority;               /* Current level. */
+    int ticks_at_priority;      /* Quantum used at that level. */
+    unsigned boost_epoch;       /* Last boost applied. */
+    int ticks_since_sleep;      /* Ticks run since the last wakeup. */
+    int64_t sleep_tick;         /* Tick at which it went to sleep. */
+    int cpu;                    /* CPU whose queues it uses. */
+
+    /* Statistics. */
+    int64_t first_run;          /* Tick first dispatched, or -1. */
+    int64_t finish;             /* Tick of exit. */
+    int64_t ready_since;        /* Tick it last became ready. */
+
+    int next;                   /* Next task in its queue, or -1. */
+  };
+
+/* A FIFO of tasks, linked through struct task's `next'. */
+struct queue
+  {
+    int head, tail;
+  };
+
+static struct task *tasks;
+static int task_cnt;
+
+/* A simulated CPU: its run queues, as in struct runqueue, and
+   the task it is running. */
+struct cpu
+  {
+    struct queue queues[MLFQ_NUM_QUEUES];
+    int running;                /* Running task, or -1 if idle. */
+  };
+
+/* The CPUs, and for each the bit mask of its nonempty queues,
+   kept apart for mlfq_policy_steal_victim(). */
+static struct cpu *cpus;
+static uint32_t *ready_masks;
+static int cpu_cnt = 1;
+
+/* Sleeping tasks, as a binary min-heap on wake tick. */
+struct sleeper
+  {
+    int64_t wake;
+    int task;
+  };
+static struct sleeper *sleep_heap;
+static int sleep_cnt, sleep_capacity;
+
+/* Policy parameters, as set by the kernel command line. */
+static struct mlfq_dispatch table[MLFQ_NUM_QUEUES];
+static int boost_interval = MLFQ_BOOST_INTERVAL;
+static bool sleep_credit;
+static unsigned boost_epoch;
+
+/* Counters. */
+static long long boosts, demotions, dispatches, wait_ticks;
+static long long steals, idle_ticks;
+
+static void usage (void);
+static void parse_table (const char *);
+static void load_trace (const char *);
+static void generate (const char *kind, int n, int64_t spread);
+static void simulate (void);
+static void report (int64_t ticks, double seconds);
+
+int
+main (int argc, char *argv[])
+{
+  static const struct option longopts[] =
+    {
+      {"tasks", required_argument, NULL, 'n'},
+      {"workload", required_argument, NULL, 'w'},
+      {"spread", required_argument, NULL, 'a'},
+      {"trace", required_argument, NULL, 'f'},
+      {"seed", required_argument, NULL, 's'},
+      {"table", required_argument, NULL, 'T'},
+      {"boost", required_argument, NULL, 'b'},
+      {"sleep-credit", no_argument, NULL, 'c'},
+      {"cpus", required_argument, NULL, 'p'},
+      {"help", no_argument, NULL, 'h'},
+      {NULL, 0, NULL, 0},
+    };
+  const char *workload = "mix";
+  const char *trace = NULL;
+  int64_t spread = -1;
+  int n = 1000;
+  clock_t start;
+  int64_t ticks;
+  int level;
+
+  for (level = 0; level < MLFQ_NUM_QUEUES; level++)
+    {
+      struct mlfq_dispatch d = MLFQ_DEFAULT_DISPATCH (level);
+      table[level] = d;
+    }
+
+  for (;;)
+    {
+      int c = getopt_long (argc, argv, "n:w:a:f:s:T:b:cp:h", longopts, NULL);
+      if (c == -1)
+        break;
+
+      switch (c)
+        {
+        case 'n':
+          n = atoi (optarg);
+          break;
+        case 'w':
+          workload = optarg;
+          break;
+        case 'a':
+          spread = atoll (optarg);
+          break;
+        case 'f':
+          trace = optarg;
+          break;
+        case 's':
+          srandom (atoi (optarg));
+          break;
+        case 'T':
+          parse_table (optarg);
+          break;
+        case 'b':
+          boost_interval = atoi (optarg);
+          break;
+        case 'c':
+          sleep_credit = true;
+          break;
+        case 'p':
+          cpu_cnt = atoi (optarg);
+          if (cpu_cnt < 1)
+            {
+              fprintf (stderr, "mlfq-sim: bad CPU count `%s'\n", optarg);
+              return EXIT_FAILURE;
+            }
+          break;
+        case 'h':
+          usage ();
+          return EXIT_SUCCESS;
+        default:
+          usage ();
+          return EXIT_FAILURE;
+        }
+    }
+  if (optind != argc)
+    {
+      usage ();
+      return EXIT_FAILURE;
+    }
+
+  if (trace != NULL)
+    load_trace (trace);
+  else
+    generate (workload, n, spread >= 0 ? spread : n);
+  if (task_cnt == 0)
+    {
+      fprintf (stderr, "mlfq-sim: no tasks\n");
+      return EXIT_FAILURE;
+    }
+
+  start = clock ();
+  simulate ();
+  ticks = 0;
+  for (n = 0; n < task_cnt; n++)
+    if (tasks[n].finish > ticks)
+      ticks = tasks[n].finish;
+  report (ticks, (double) (clock () - start) / CLOCKS_PER_SEC);
+  return EXIT_SUCCESS;
+}
+
+static void
+usage (void)
+{
+  printf ("mlfq-sim, simulates the Pintos MLFQ scheduler on a workload\n"
+          "usage: mlfq-sim [OPTION...]\n"
+          "  -n, --tasks=N        Generate N tasks (default 1000).\n"
+          "  -w, --workload=KIND  Generate KIND tasks: cpu, io or mix\n"
+          "                       (default mix, one in five cpu).\n"
+          "  -a, --spread=TICKS   Spread arrivals over the first TICKS\n"
+          "                       ticks (default: one per task).\n"
+          "  -f, --trace=FILE     Read tasks from FILE instead, one per\n"
+          "                       line as ARRIVAL BURST SLEEP BURSTS.\n"
+          "  -s, --seed=SEED      Seed the workload generator.\n"
+          "  -T, --table=L:Q:E:S:W,...\n"
+          "                       Override dispatch table entries, as\n"
+          "                       the kernel's -mlfqs-table does.\n"
+          "  -b, --boost=TICKS    Boost every TICKS ticks (0: never).\n"
+          "  -c, --sleep-credit   Move sleepers up on wakeup, as the\n"
+          "                       kernel's -mlfqs-sleep-credit does.\n"
+          "  -p, --cpus=N         Simulate N CPUs, each with its own run\n"
+          "                       queues, stealing when idle (default 1).\n");
+}
+
+/* Parses VALUE as the kernel's -mlfqs-table option does, but
+   exits on error.  The kernel also turns on starvation checks for
+   nonzero maxwait, which the simulator does not model. */
+static void
+parse_table (const char *value)
+{
+  const char *p = value;
+
+  while (*p != '\0')
+    {
+      struct mlfq_dispatch d;
+      int level, len;
+
+      if (sscanf (p, "%d:%d:%d:%d:%d%n", &level, &d.quantum, &d.tqexp,
+                  &d.slpret, &d.maxwait, &len) != 5
+          || level < MLFQ_PRIORITY_MIN || level > MLFQ_PRIORITY_MAX
+          || d.quantum < 1
+          || d.tqexp < MLFQ_PRIORITY_MIN || d.tqexp > MLFQ_PRIORITY_MAX
+          || d.slpret < MLFQ_PRIORITY_MIN || d.slpret > MLFQ_PRIORITY_MAX
+          || d.maxwait < 0)
+        {
+          fprintf (stderr, "mlfq-sim: bad table entry at `%s'\n", p);
+          exit (EXIT_FAILURE);
+        }
+      table[level] = d;
+      p += len;
+      if (*p == ',')
+        p++;
+      else if (*p != '\0')
+        {
+          fprintf (stderr, "mlfq-sim: bad table entry at `%s'\n", p);
+          exit (EXIT_FAILURE);
+        }
+    }
+}
+
+/* Makes room for one more task and returns it, zeroed except for
+   the fields that mean "not yet". */
+static struct task *
+new_task (void)
+{
+  static int capacity;
+  struct task *t;
+
+  if (task_cnt == capacity)
+    {
+      capacity = capacity ? capacity * 2 : 1024;
+      tasks = realloc (tasks, capacity * sizeof *tasks);
+      if (tasks == NULL)
+        {
+          fprintf (stderr, "mlfq-sim: out of memory\n");
+          exit (EXIT_FAILURE);
+        }
+    }
+  t = &tasks[task_cnt++];
+  memset (t, 0, sizeof *t);
+  t->priority = MLFQ_PRIORITY_MAX;
+  t->first_run = -1;
+  t->next = -1;
+  return t;
+}
+
+/* Appends a task with the given workload. */
+static void
+add_task (int64_t arrival, int burst, int sleep, int bursts)
+{
+  struct task *t = new_task ();
+
+  t->arrival = arrival;
+  t->burst = burst;
+  t->sleep = sleep;
+  t->bursts_left = bursts;
+  t->run_left = burst;
+  t->boost_epoch = boost_epoch;
+}
+
+static void
+load_trace (const char *file)
+{
+  FILE *f = fopen (file, "r");
+  char line[256];
+  int line_no = 0;
+
+  if (f == NULL)
+    {
+      fprintf (stderr, "mlfq-sim: %s: %s\n", file, strerror (errno));
+      exit (EXIT_FAILURE);
+    }
+  while (fgets (line, sizeof line, f) != NULL)
+    {
+      long long arrival;
+      int burst, sleep, bursts;
+      char *p = line + strspn (line, " \t");
+
+      line_no++;
+      if (*p == '#' || *p == '\n' || *p == '\0')
+        continue;
+      if (sscanf (p, "%lld %d %d %d", &arrival, &burst, &sleep, &bursts) != 4
+          || arrival < 0 || burst < 1 || sleep < 0 || bursts < 1)
+        {
+          fprintf (stderr, "mlfq-sim: %s:%d: bad task\n", file, line_no);
+          exit (EXIT_FAILURE);
+        }
+      add_task (arrival, burst, sleep, bursts);
+    }
+  fclose (f);
+}
+
+/* Returns a random integer between LO and HI, inclusive. */
+static int
+random_range (int lo, int hi)
+{
+  return lo + random () % (hi - lo + 1);
+}
+
+/* Generates N tasks of KIND arriving over the first SPREAD
+   ticks: "cpu" tasks run one long burst, "io" tasks run many
+   short bursts between sleeps, and "mix" is one cpu task in five
+   among io tasks. */
+static void
+generate (const char *kind, int n, int64_t spread)
+{
+  bool cpu = !strcmp (kind, "cpu");
+  bool io = !strcmp (kind, "io");
+  int i;
+
+  if (!cpu && !io && strcmp (kind, "mix"))
+    {
+      fprintf (stderr, "mlfq-sim: unknown workload `%s'\n", kind);
+      exit (EXIT_FAILURE);
+    }
+
+  for (i = 0; i < n; i++)
+    {
+      int64_t arrival = spread > 0 ? random () % spread : 0;
+
+      if (cpu || (!io && random () % 5 == 0))
+        add_task (arrival, random_range (50, 500), 0, 1);
+      else
+        add_task (arrival, random_range (1, 3), random_range (5, 20),
+                  random_range (20, 100));
+    }
+}
+
+/* Appends task I to queue Q. */
+static void
+queue_push (struct queue *q, int i)
+{
+  tasks[i].next = -1;
+  if (q->head < 0)
+    q->head = i;
+  else
+    tasks[q->tail].next = i;
+  q->tail = i;
+}
+
+/* Makes task I ready at NOW on its CPU, applying any boost it
+   missed. */
+static void
+make_ready (int i, int64_t now)
+{
+  struct task *t = &tasks[i];
+
+  mlfq_policy_apply_boost (boost_epoch, &t->priority, &t->ticks_at_priority,
+                           &t->boost_epoch);
+  t->ready_since = now;
+  queue_push (&cpus[t->cpu].queues[t->priority], i);
+  ready_masks[t->cpu] |= 1u << t->priority;
+}
+
+/* Removes and returns the first task in CPU's highest nonempty
+   queue, as mlfq_dequeue_highest() does. */
+static int
+dequeue_highest (int cpu)
+{
+  int level = mlfq_policy_pick (ready_masks[cpu]);
+  struct queue *q = &cpus[cpu].queues[level];
+  int i = q->head;
+
+  q->head = tasks[i].next;
+  if (q->head < 0)
+    ready_masks[cpu] &= ~(1u << level);
+  mlfq_policy_apply_boost (boost_epoch, &tasks[i].priority,
+                           &tasks[i].ticks_at_priority,
+                           &tasks[i].boost_epoch);
+  return i;
+}
+
+/* Takes a task for idle CPU from the busiest peer, or returns -1
+   if no peer has one ready. */
+static int
+steal (int cpu)
+{
+  int victim = mlfq_policy_steal_victim (ready_masks, cpu_cnt, cpu);
+  int i;
+
+  if (victim < 0)
+    return -1;
+  i = dequeue_highest (victim);
+  tasks[i].cpu = cpu;
+  steals++;
+  return i;
+}
+
+/* Applies the latest boost to CPU, as mlfq_boost_all() does:
+   splices every lower queue onto the top one, lowest first,
+   boosts the running task and leaves each ready task to apply
+   the boost when it is dispatched. */
+static void
+boost_all (int cpu)
+{
+  struct queue *top = &cpus[cpu].queues[MLFQ_PRIORITY_MAX];
+  int running = cpus[cpu].running;
+  int level;
+
+  for (level = MLFQ_PRIORITY_MIN; level < MLFQ_PRIORITY_MAX; level++)
+    {
+      struct queue *q = &cpus[cpu].queues[level];
+
+      if (q->head < 0)
+        continue;
+      if (top->head < 0)
+        top->head = q->head;
+      else
+        tasks[top->tail].next = q->head;
+      top->tail = q->tail;
+      q->head = q->tail = -1;
+    }
+  ready_masks[cpu] = top->head < 0 ? 0 : 1u << MLFQ_PRIORITY_MAX;
+
+  if (running >= 0)
+    mlfq_policy_apply_boost (boost_epoch, &tasks[running].priority,
+                             &tasks[running].ticks_at_priority,
+                             &tasks[running].boost_epoch);
+}
+
+/* Puts task I to sleep until WAKE. */
+static void
+sleep_push (int i, int64_t wake)
+{
+  int child = sleep_cnt++;
+
+  if (sleep_cnt > sleep_capacity)
+    {
+      sleep_capacity = sleep_capacity ? sleep_capacity * 2 : 1024;
+      sleep_heap = realloc (sleep_heap, sleep_capacity * sizeof *sleep_heap);
+      if (sleep_heap == NULL)
+        {
+          fprintf (stderr, "mlfq-sim: out of memory\n");
+          exit (EXIT_FAILURE);
+        }
+    }
+  while (child > 0 && sleep_heap[(child - 1) / 2].wake > wake)
+    {
+      sleep_heap[child] = sleep_heap[(child - 1) / 2];
+      child = (child - 1) / 2;
+    }
+  sleep_heap[child].wake = wake;
+  sleep_heap[child].task = i;
+}
+
+/* Removes and returns the earliest sleeper. */
+static int
+sleep_pop (void)
+{
+  int i = sleep_heap[0].task;
+  struct sleeper last = sleep_heap[--sleep_cnt];
+  int parent = 0;
+
+  for (;;)
+    {
+      int child = 2 * parent + 1;
+
+      if (child >= sleep_cnt)
+        break;
+      if (child + 1 < sleep_cnt
+          && sleep_heap[child + 1].wake < sleep_heap[child].wake)
+        child++;
+      if (sleep_heap[child].wake >= last.wake)
+        break;
+      sleep_heap[parent] = sleep_heap[child];
+      parent = child;
+    }
+  if (sleep_cnt > 0)
+    sleep_heap[parent] = last;
+  return i;
+}
+
+/* Wakes task I at NOW, as timer_interrupt() does: the table's
+   slpret level, moved up by sleep credit if enabled, keeping the
+   quantum used only if the level is unchanged. */
+static void
+wake (int i, int64_t now)
+{
+  struct task *t = &tasks[i];
+  int level = table[t->priority].slpret;
+
+  if (sleep_credit)
+    level = mlfq_policy_sleep_credit (table, level, now - t->sleep_tick,
+                                      t->ticks_since_sleep);
+  t->ticks_since_sleep = 0;
+  t->ticks_at_priority = mlfq_policy_wake_ticks (t->priority,
+                                                 t->ticks_at_priority, level);
+  t->priority = level;
+  make_ready (i, now);
+}
+
+/* Compares tasks by arrival, for qsort(). */
+static int
+compare_arrival (const void *a_, const void *b_)
+{
+  const struct task *a = a_;
+  const struct task *b = b_;
+
+  return a->arrival < b->arrival ? -1 : a->arrival > b->arrival;
+}
+
+/* Runs every task to completion. */
+static void
+simulate (void)
+{
+  int64_t now = 0;
+  int64_t since_boost = 0;
+  int next_arrival = 0;
+  int done = 0;
+  int c, level;
+
+  cpus = calloc (cpu_cnt, sizeof *cpus);
+  ready_masks = calloc (cpu_cnt, sizeof *ready_masks);
+  if (cpus == NULL || ready_masks == NULL)
+    {
+      fprintf (stderr, "mlfq-sim: out of memory\n");
+      exit (EXIT_FAILURE);
+    }
+  for (c = 0; c < cpu_cnt; c++)
+    {
+      for (level = 0; level < MLFQ_NUM_QUEUES; level++)
+        cpus[c].queues[level].head = cpus[c].queues[level].tail = -1;
+      cpus[c].running = -1;
+    }
+  qsort (tasks, task_cnt, sizeof *tasks, compare_arrival);
+
+  while (done < task_cnt)
+    {
+      bool busy = false;
+      bool boost;
+
+      /* New tasks, spread round robin over the CPUs, and woken
+         tasks, on the CPU they last ran on. */
+      while (next_arrival < task_cnt && tasks[next_arrival].arrival <= now)
+        {
+          tasks[next_arrival].cpu = next_arrival % cpu_cnt;
+          make_ready (next_arrival++, now);
+        }
+      while (sleep_cnt > 0 && sleep_heap[0].wake <= now)
+        wake (sleep_pop (), now);
+
+      for (c = 0; c < cpu_cnt; c++)
+        {
+          struct cpu *cpu = &cpus[c];
+
+          /* A task ready above the running one preempts it. */
+          if (cpu->running >= 0 && ready_masks[c] != 0
+              && (mlfq_policy_pick (ready_masks[c])
+                  > tasks[cpu->running].priority))
+            {
+              make_ready (cpu->running, now);
+              cpu->running = -1;
+            }
+
+          /* Otherwise an idle CPU takes its own highest task, or
+             steals one. */
+          if (cpu->running < 0)
+            {
+              int i = ready_masks[c] != 0 ? dequeue_highest (c) : steal (c);
+              struct task *t;
+
+              if (i < 0)
+                continue;
+              cpu->running = i;
+              t = &tasks[i];
+              if (t->first_run < 0)
+                t->first_run = now;
+              wait_ticks += now - t->ready_since;
+              dispatches++;
+            }
+          busy = true;
+        }
+
+      if (!busy)
+        {
+          /* Every CPU idle: skip to the next arrival or wakeup. */
+          int64_t next = INT64_MAX;
+
+          if (next_arrival < task_cnt)
+            next = tasks[next_arrival].arrival;
+          if (sleep_cnt > 0 && sleep_heap[0].wake < next)
+            next = sleep_heap[0].wake;
+          idle_ticks += (next - now) * cpu_cnt;
+          now = next;
+          continue;
+        }
+
+      /* The boost clock advances the epoch once; each CPU then
+         applies it to its own queues below. */
+      boost = boost_interval > 0 && ++since_boost >= boost_interval;
+      if (boost)
+        {
+          boost_epoch++;
+          boosts++;
+          since_boost = 0;
+        }
+
+      /* Run each CPU's task for a tick, as thread_tick() accounts
+         it. */
+      now++;
+      for (c = 0; c < cpu_cnt; c++)
+        {
+          struct cpu *cpu = &cpus[c];
+          struct task *t;
+          bool preempt;
+
+          if (cpu->running < 0)
+            {
+              if (boost)
+                boost_all (c);
+              idle_ticks++;
+              continue;
+            }
+
+          t = &tasks[cpu->running];
+          t->run_left--;
+          t->ticks_since_sleep++;
+          level = t->priority;
+          preempt = mlfq_policy_charge (table, &t->priority,
+                                        &t->ticks_at_priority);
+          if (t->priority < level)
+            demotions++;
+          if (boost)
+            {
+              boost_all (c);
+              preempt = true;
+            }
+
+          if (t->run_left == 0)
+            {
+              if (--t->bursts_left == 0)
+                {
+                  t->finish = now;
+                  done++;
+                }
+              else
+                {
+                  t->run_left = t->burst;
+                  if (t->sleep > 0)
+                    {
+                      t->sleep_tick = now;
+                      sleep_push (cpu->running, now + t->sleep);
+                    }
+                  else
+                    make_ready (cpu->running, now);
+                }
+              cpu->running = -1;
+            }
+          else if (preempt)
+            {
+              make_ready (cpu->running, now);
+              cpu->running = -1;
+            }
+        }
+    }
+}
+
+/* Compares int64_t values, for qsort(). */
+static int
+compare_int64 (const void *a_, const void *b_)
+{
+  const int64_t *a = a_;
+  const int64_t *b = b_;
+
+  return *a < *b ? -1 : *a > *b;
+}
+
+/* Prints the mean, median, 99th percentile and maximum of the N
+   values in V, sorting V. */
+static void
+print_distribution (const char *name, int64_t *v, int n)
+{
+  long double sum = 0;
+  int i;
+
+  qsort (v, n, sizeof *v, compare_int64);
+  for (i = 0; i < n; i++)
+    sum += v[i];
+  printf ("%s: mean %.1Lf, p50 %lld, p99 %lld, max %lld ticks\n",
+          name, sum / n, (long long) v[(n - 1) / 2],
+          (long long) v[(int) ((n - 1) * 0.99)], (long long) v[n - 1]);
+}
+
+static void
+report (int64_t ticks, double seconds)
+{
+  int64_t *v = malloc (task_cnt * sizeof *v);
+  int i;
+
+  if (v == NULL)
+    {
+      fprintf (stderr, "mlfq-sim: out of memory\n");
+      exit (EXIT_FAILURE);
+    }
+
+  printf ("tasks: %d in %lld ticks, simulated at %.0f ticks/s\n",
+          task_cnt, (long long) ticks, seconds > 0 ? ticks / seconds : 0.0);
+  printf ("throughput: %.3f tasks/1000 ticks\n",
+          ticks > 0 ? 1000.0 * task_cnt / ticks : 0.0);
+
+  for (i = 0; i < task_cnt; i++)
+    v[i] = tasks[i].finish - tasks[i].arrival;
+  print_distribution ("turnaround", v, task_cnt);
+  for (i = 0; i < task_cnt; i++)
+    v[i] = tasks[i].first_run - tasks[i].arrival;
+  print_distribution ("response", v, task_cnt);
+
+  printf ("dispatches: %lld, mean wait %.2f ticks\n", dispatches,
+          dispatches > 0 ? (double) wait_ticks / dispatches : 0.0);
+  printf ("boosts: %lld, demotions: %lld\n", boosts, demotions);
+  if (cpu_cnt > 1)
+    printf ("cpus: %d, steals: %lld, idle: %lld cpu-ticks\n", cpu_cnt,
+            steals, idle_ticks);
+  free (v);
+}